@@ -149,6 +149,7 @@ void Overloadset::push_back(Function* function){
 Function::Function(SymbolID name,Location& location) : PrefixDefinition(name,location), body(), allArgMatcher(body.scope,nullptr) {
 	intrinsicCTFEbinder = nullptr;
 	generatedFunctionParent = nullptr;
+	specializations = nullptr;
 	body.scope->_functionOwner = this;
 	cc = data::ast::Function::ARPHA;
 	miscFlags = 0;
@@ -169,7 +170,7 @@ bool   Function::applyProperty(SymbolID name,Node* value){
 		if(value){
 			auto str = value->asStringLiteral();
 			if(!str) return false;
-			externalLib = str->block.ptr();
+			externalLib = str->block.duplicate().ptr();//NB: string literals aren't always terminated by '\0'
 			auto ext = System::path::extension(externalLib);
 			if(ext){
 				if(!strcmp(ext,"dll")){
@@ -299,7 +300,7 @@ Function* Function::reallyDuplicate(DuplicationModifiers* mods,bool redefine){
 	debug("Duplicating function %s",label());
 	auto func = new Function(label(),location());
 	if(redefine) mods->duplicateDefinition(const_cast<Function*>(this),func);
-	func->body.scope->parent = mods->target;
+	func->body.scope->changeParent(mods->target);
 	mods->target = func->body.scope;
 	
 	//args
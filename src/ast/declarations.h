@@ -231,6 +231,7 @@ struct Function: public PrefixDefinition {
 
 	//Used to specialise a function with type pattern and/or expandable parameters
 	Function* specializationExists(Type** specializedParameters,Node** passedExpressions,Scope* usageScope);
+	bool matchesSpecialization(Function* alreadyGenerated,Type** specializedParameters,Node** passedExpressions,Scope* usageScope);
 	Function* specializedDuplicate(DuplicationModifiers* mods,Type** specializedParameters,Node** passedExpressions);
 
 	Function* reallyDuplicate(DuplicationModifiers* mods,bool redefine = true);
@@ -263,6 +264,8 @@ struct Function: public PrefixDefinition {
 	Function* generatedFunctionParent;
 	std::vector<Function*> generatedFunctions;
 	std::vector<Node*>     expandedArguments ;
+	struct SpecializationIndex;
+	SpecializationIndex*   specializations;//The generated functions indexed by the parameters which they were specialized for
 	
 	DECLARE_NODE(Function);
 private:
@@ -189,6 +189,8 @@ CTFEinvocation::CTFEinvocation(CompilationUnit* compilationUnit,Function* functi
 CTFEinvocation::~CTFEinvocation(){
 }
 bool CTFEinvocation::invoke(Node* parameter){
+	//The interpreter is shared by the resolvers of the module
+	compiler::SharedStateLock lock;
 	if(parameter)
 		assert(parameter->isConst());
 
@@ -221,6 +223,7 @@ Node* CTFEinvocation::getValue(const Variable* variable){
 CTFEintrinsicInvocation::CTFEintrinsicInvocation(CompilationUnit* compilationUnit) : _compilationUnit(compilationUnit) {
 }
 bool CTFEintrinsicInvocation::invoke(Function* function,Node* parameter){
+	compiler::SharedStateLock lock;
 	assert(function->isIntrinsic() && function->intrinsicCTFEbinder);
 	auto t = parameter->asTupleExpression();
 	_params = t ? t->childrenPtr() : &parameter;
@@ -250,9 +253,9 @@ SymbolID CTFEintrinsicInvocation::getStringParameterAsSymbol(uint16 id) const {
 	auto str = _params[id]->asStringLiteral();
 	return SymbolID(str->block.ptr(),str->block.length());
 }
-const char* CTFEintrinsicInvocation::getStringParameter(uint16 id) const {
+std::string CTFEintrinsicInvocation::getStringParameter(uint16 id) const {
 	auto str = _params[id]->asStringLiteral();
-	return str->block.ptr();
+	return std::string(str->block.ptr(),str->block.length());
 }
 Parser*  CTFEintrinsicInvocation::getParser() const {
 	return _compilationUnit->parser;
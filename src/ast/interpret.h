@@ -44,7 +44,7 @@ struct CTFEintrinsicInvocation {
 	bool     getBoolParameter(uint16 id) const;
 	Type*    getTypeParameter(uint16 id) const;
 	Node*    getNodeParameter(uint16 id) const;
-	const char* getStringParameter(uint16 id) const;
+	std::string getStringParameter(uint16 id) const;
 	SymbolID getStringParameterAsSymbol(uint16 id) const;
 	int      getInt32Parameter(uint16 id)  const;
 	uint32   getUint32Parameter(uint16 id) const;
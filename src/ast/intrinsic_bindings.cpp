@@ -338,7 +338,7 @@ static void initMapping(){
 			}
 			subBlock->addChild(i == 0? body : body->duplicate(&mods));
 			block->addChild(subBlock);
-			subBlock->scope->parent = block->scope;
+			subBlock->scope->changeParent(block->scope);
 		}
 		invocation->ret(block);
 	});
@@ -8,25 +8,43 @@
 #include "interpret.h"
 #include "../intrinsics/types.h"
 
+void DuplicationModifiers::redirect(void* original,void* node,int kind){
+	Redirector redirector = { node,kind };
+	redirectors[original] = redirector;
+}
 void DuplicationModifiers::expandArgument(Argument* original,Node* value){
-	redirectors[reinterpret_cast<void*>(static_cast<Variable*>(original))] = std::make_pair(reinterpret_cast<void*>(value),true);
+	redirect(static_cast<Variable*>(original),value,Redirector::EXPRESSION);
+}
+//The blocks which don't define anything are spliced as their only expression
+static Node* spliceable(Node* value){
+	if(auto v = value->asNodeReference()){
+		auto node = v->node();
+		if(auto block = node->asBlockExpression()){
+			if(block->scope->numberOfDefinitions() == 0 && block->children.size() == 1) node = block->children[0];
+		}
+		return node;
+	}
+	return value;
+}
+void DuplicationModifiers::splice(Variable* variable,Node* value){
+	redirect(variable,spliceable(value),Redirector::SPLICE);
 }
 
 void DuplicationModifiers::duplicateDefinition(Argument* original,Argument* duplicate){
 	//target->define(duplicate); argument defined in duplicate function addChild 
-	redirectors[reinterpret_cast<void*>(static_cast<Variable*>(original))] = std::make_pair(reinterpret_cast<void*>(static_cast<Variable*>(duplicate)),false);
+	redirect(static_cast<Variable*>(original),static_cast<Variable*>(duplicate),Redirector::DEFINITION);
 }
 void DuplicationModifiers::duplicateDefinition(Variable* original,Variable* duplicate){
 	if(redefine && !original->label().isNull()) target->define(duplicate);
-	redirectors[reinterpret_cast<void*>(original)] = std::make_pair(reinterpret_cast<void*>(duplicate),false);
+	redirect(original,duplicate,Redirector::DEFINITION);
 }
 void DuplicationModifiers::duplicateDefinition(Function* original,Function* duplicate){
 	if(redefine && !original->label().isNull()) target->defineFunction(duplicate);
-	redirectors[reinterpret_cast<void*>(original)] = std::make_pair(reinterpret_cast<void*>(duplicate),false);
+	redirect(original,duplicate,Redirector::DEFINITION);
 }
 void DuplicationModifiers::duplicateDefinition(TypeDeclaration* original,TypeDeclaration* duplicate){
 	if(redefine) target->define(duplicate);
-	redirectors[reinterpret_cast<void*>(original)] = std::make_pair(reinterpret_cast<void*>(duplicate),false);
+	redirect(original,duplicate,Redirector::DEFINITION);
 }
 void DuplicationModifiers::duplicateDefinition(PrefixMacro* original,PrefixMacro* duplicate){
 	if(redefine) target->define(duplicate);
@@ -36,8 +54,8 @@ void DuplicationModifiers::duplicateDefinition(InfixMacro* original,InfixMacro*
 }
 
 TypeDeclaration* DuplicationModifiers::getDuplicate(TypeDeclaration* original){
-	auto r = redirectors.find(reinterpret_cast<void*>(original));
-	return r == redirectors.end()? original : reinterpret_cast<TypeDeclaration*>(r->second.first);
+	auto r = redirectors.find(original);
+	return r? reinterpret_cast<TypeDeclaration*>(r->node) : original;
 }
 
 void Node::setFlag(uint16 id){
@@ -152,7 +170,9 @@ Type* StringLiteral::returnType() const{
 	return explicitType;
 }
 Node* StringLiteral::duplicate(DuplicationModifiers* mods) const {
-	return copyProperties(new StringLiteral(block.duplicate(),explicitType));
+	//Blocks without ownership point to module sources or symbols, which outlive the AST
+	auto dup = block.hasOwnership()? block.duplicate() : block;
+	return copyProperties(new StringLiteral(dup,explicitType));
 }
 
 ArrayExpression::ArrayExpression() :explicitType(nullptr) {}
@@ -195,23 +215,13 @@ Type* VariableReference::returnType() const {
 }
 Node* VariableReference::duplicate(DuplicationModifiers* mods) const {
 	if(mods->expandedMacroOptimization){
-		if(auto value = mods->expandedMacroOptimization->getValue(variable)){
-			if(auto v = value->asNodeReference()){
-				//Simplify blocks
-				auto node = v->node();
-				if(auto block = node->asBlockExpression()){
-					if(block->scope->numberOfDefinitions() == 0 && block->children.size() == 1) node = block->children[0];
-				}
-				return node->duplicate(mods);
-			}
-			return value->duplicate(mods);
-		}
+		if(auto value = mods->expandedMacroOptimization->getValue(variable)) return spliceable(value)->duplicate(mods);
 	}
-	auto red = mods->redirectors.find(variable);
-	if(red != mods->redirectors.end()){
+	if(auto red = mods->redirectors.find(variable)){
+		if(red->kind == DuplicationModifiers::Redirector::SPLICE) return reinterpret_cast<Node*>(red->node)->duplicate(mods);
 		Node* result;
-		if((*red).second.second) result = reinterpret_cast<Node*>((*red).second.first)->duplicate(mods);
-		else result = new VariableReference(reinterpret_cast<Variable*>((*red).second.first));
+		if(red->kind == DuplicationModifiers::Redirector::EXPRESSION) result = reinterpret_cast<Node*>(red->node)->duplicate(mods);
+		else result = new VariableReference(reinterpret_cast<Variable*>(red->node));
 		return copyProperties(result);
 	}
 	return copyProperties(new VariableReference(variable));
@@ -448,7 +458,7 @@ Node* BlockExpression::duplicate(DuplicationModifiers* mods) const {
 	}
 	else{
 		auto dup = new BlockExpression();
-		dup->scope->parent = mods->target;
+		dup->scope->changeParent(mods->target);
 		mods->target = dup->scope;
 		_duplicate(dup,mods);
 		mods->target = mods->target->parent;
@@ -488,16 +498,35 @@ Node* ScopedCommand::duplicate(DuplicationModifiers* mods) const {
 }
 
 
-NodeReference::NodeReference(Node* node) : _node(node) {
+NodeReference::NodeReference(Node* node) : _node(node),_splices(nullptr) {
 	setFlag(CONSTANT | RESOLVED);
 }
 Type* NodeReference::returnType() const { 
 	return intrinsics::types::NodePointer; 
 }
+NodeReference::Splices* NodeReference::Splices::duplicate(DuplicationModifiers* mods){
+	bool redirected = false;
+	for(auto i = variables.begin();i!=variables.end();++i){
+		if(mods->redirectors.find(*i)){
+			redirected = true;
+			break;
+		}
+	}
+	if(!redirected) return this;
+	auto result = new Splices;
+	for(auto i = variables.begin();i!=variables.end();++i){
+		auto red = mods->redirectors.find(*i);
+		if(!red) result->variables.push_back(*i);
+		else if(red->kind == DuplicationModifiers::Redirector::DEFINITION) result->variables.push_back(reinterpret_cast<Variable*>(red->node));
+		//The references to the variables which are replaced by expressions aren't splice points anymore
+	}
+	return result;
+}
 Node* NodeReference::duplicate(DuplicationModifiers* mods) const {
 	auto old = mods->redefine;
 	mods->redefine = false;
 	auto expr = copyProperties(new NodeReference(isFlagSet(DONT_DUPLICATE_OBJECT)? _node : _node->duplicate(mods)));
+	if(_splices) static_cast<NodeReference*>(expr)->_splices = isFlagSet(DONT_DUPLICATE_OBJECT)? _splices : _splices->duplicate(mods);
 	mods->redefine = old;
 	return expr;
 }
@@ -552,6 +581,7 @@ Node* ErrorExpression::duplicate(DuplicationModifiers* mods) const {
 	return errorInstance;//NB an instance is already created, so we dont have to use getInstance
 };
 ErrorExpression* ErrorExpression::getInstance() {
+	compiler::SharedStateLock lock;
 	if(errorInstance) return errorInstance;
 	else return errorInstance = new ErrorExpression;
 }
@@ -580,7 +610,7 @@ bool  BoolExpression::isSame(Node* other){
 	return false;
 }
 bool  StringLiteral::isSame(Node* other){
-	if(auto node = other->asStringLiteral()) return strcmp(block.ptr(),node->block.ptr()) == 0;
+	if(auto node = other->asStringLiteral()) return block.length() == node->block.length() && memcmp(block.ptr(),node->block.ptr(),block.length()) == 0;
 	return false;
 }
 bool  UnitExpression::isSame(Node* other){
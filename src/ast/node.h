@@ -96,14 +96,24 @@ struct DuplicationModifiers {
 	CTFEinvocation* expandedMacroOptimization;//when a macro returns [> $x <] we replace x with a value during mixining into the caller's body
 
 	bool redefine;
-	//The bool indicates whether the redirector is expression(true) or a definition(false)
-	std::map<void*,std::pair<void*,bool> > redirectors;//Used to redirect references for duplicated definitions
+	struct Redirector {
+		enum {
+			DEFINITION,//The references are redirected to the duplicated definition
+			EXPRESSION,//The references are replaced by a duplicate of the expression, which gets the reference's properties
+			SPLICE     //The references are replaced by a duplicate of the node which is spliced into a quasi-quote
+		};
+		void* node;
+		int   kind;
+	};
+	SmallHashMap<void*,Redirector> redirectors;//Used to redirect references for duplicated definitions
 	
 	Variable* returnValueRedirector;//The variable to which the return value is assigned in inlined and mixined functions
 
 	DuplicationModifiers(Scope* target) : returnValueRedirector(nullptr),expandedMacroOptimization(nullptr),redefine(true) { this->target = target; }
 
+	void redirect(void* original,void* node,int kind);
 	void expandArgument(Argument* original,Node* value);
+	void splice(Variable* variable,Node* value);
 	void duplicateDefinition(Argument* original,Argument* duplicate);
 	void duplicateDefinition(Variable* original,Variable* duplicate);
 	void duplicateDefinition(Function* original,Function* duplicate);
@@ -134,6 +144,10 @@ public:
 
 	inline Node() : flags(0) {}
 
+	//Nodes are allocated in the current memory region and freed together with it.
+	inline void* operator new(size_t size){ return memory::allocate(size); }
+	inline void operator delete(void* p){}
+
 	void setFlag  (uint16 id);
 	bool isFlagSet(uint16 id) const ;
 	inline bool isResolved() const { return isFlagSet(RESOLVED); }
@@ -349,10 +363,24 @@ struct NodeReference : Node {
         
 	Type* returnType() const;
     Node* node() const { return _node; }
+
+	/**
+		A reference to a quasi-quote [> <] records the variables which are spliced into it using '$' when it's parsed.
+		A macro expansion then patches only these splice points, without checking every variable reference in the template.
+	*/
+	struct Splices {
+		std::vector<Variable*> variables;
+
+		//The variables are redirected to their duplicates when the macro which contains the quasi-quote is duplicated
+		Splices* duplicate(DuplicationModifiers* mods);
+	};
+	inline Splices* splices() const { return _splices; }
+	inline void splices(Splices* splices){ _splices = splices; }
       
 	DECLARE_NODE(NodeReference);
 private:
     Node* _node;
+	Splices* _splices;
 };
 
 // Type checks the expression, returning an expression which fits the expectedType or null if the types don't match
@@ -14,9 +14,9 @@
 
 using namespace data::ast::Operations;
 
-/**
-* TODO proper implementation,unittests
-*/
+//Shifting by more than this always overflows
+static const size_t maxShift = 4096;
+
 void   doCalculation(data::ast::Operations::Kind op,BigInt& operand1,BigInt& operand2){
 	switch(op){
 	case NEGATION:
@@ -24,46 +24,55 @@ void   doCalculation(data::ast::Operations::Kind op,BigInt& operand1,BigInt& ope
 		break;
 
 	case ADDITION:
-		operand1.u64 = operand1.u64 + operand2.u64;
+		operand1 += operand2;
 		break;
 	case SUBTRACTION:
-		operand1.u64 = operand1.u64 - operand2.u64;
+		operand1 -= operand2;
 		break;
 	case MULTIPLICATION:
-		operand1.u64 = operand1.u64 * operand2.u64;
+		operand1 *= operand2;
 		break;
 	case DIVISION:
-		operand1.u64 = operand1.u64 / operand2.u64;
+		operand1 /= operand2;
 		break;
 	case REMAINDER:
-		operand1.u64 = operand1.u64 % operand2.u64;
+		operand1 %= operand2;
 		break;
 
 	case BIT_NOT:
-		operand1.u64 = ~operand1.u64;
+		//Inverts the bits of the magnitude's words
+		if(operand1.isWord()){
+			operand1.u64 = ~operand1.u64;
+			if(operand1.isZero()) operand1.negative = false;
+		} else {
+			BigInt mask((uint64)1);
+			mask <<= size_t(64*operand1.wordCount);
+			mask -= BigInt((uint64)1);
+			operand1 ^= mask;
+		}
 		break;
 	case BIT_AND:
-		operand1.u64 = operand1.u64 & operand2.u64;
+		operand1 &= operand2;
 		break;
 	case BIT_OR:
-		operand1.u64 = operand1.u64 | operand2.u64;
+		operand1 |= operand2;
 		break;
 	case BIT_XOR:
-		operand1.u64 = operand1.u64 ^ operand2.u64;
+		operand1 ^= operand2;
 		break;
 
 	case LEFT_SHIFT:
-		operand1.u64 = operand1.u64 << operand2.u64;
+		operand1 <<= operand2.isWord() && operand2.u64 < maxShift? size_t(operand2.u64) : maxShift;
 		break;
 	case RIGHT_SHIFT:
-		operand1.u64 = operand1.u64 >> operand2.u64;
+		operand1 >>= operand2.isWord() && operand2.u64 < maxShift? size_t(operand2.u64) : maxShift;
 		break;
 	}
 }
 
 bool   integerOverflowOccured(Type* resultingType,data::ast::Operations::Kind op,BigInt& result){
 	if( (op >= NEGATION && op <= REMAINDER) || op == LEFT_SHIFT){
-		return !resultingType->integerFits(result.u64,result.isNegative());
+		return !resultingType->integerFits(result);
 	}
 	return false;
 }
@@ -177,12 +186,25 @@ Node* evaluateConstantOperation(data::ast::Operations::Kind op,Node* parameter){
 		auto int0= params[0]->asIntegerLiteral();
 		BigInt& operand1 = int0->integer; 
 		if(isCalculationOperation(op)){ 
-			doCalculation(op,operand1,calculationOperationNumberOfParameters(op) == 1? operand1 : params[1]->asIntegerLiteral()->integer); 
+			BigInt& operand2 = calculationOperationNumberOfParameters(op) == 1? operand1 : params[1]->asIntegerLiteral()->integer;
+			if((op == DIVISION || op == REMAINDER) && operand2.isZero()){
+				error(params[1],"Division by zero occured when performing an integer calculation at compile time");
+				return params[0];
+			}
+			doCalculation(op,operand1,operand2); 
 			if(int0->isUntypedLiteral()){
+				//The untyped result has to fit into one of the widest integer types
+				if(!intrinsics::types::int64->integerFits(operand1) && !intrinsics::types::uint64->integerFits(operand1)){
+					error(params[0],"Integer overflow occured when performing an integer calculation at compile time");
+					return ErrorExpression::getInstance();
+				}
 				int0->explicitType = Type::getBestFitIntegerType(int0->integer); //NB: required after operations which overflow, e.g. 2billion :: int32 + 1billion :: int32 = 3billion :: uint32
 			}
 			else{
-				if(integerOverflowOccured(ret,op,operand1)) error(params[0],"Integer overflow occured when performing an integer calculation at compile time");
+				if(integerOverflowOccured(ret,op,operand1)){
+					error(params[0],"Integer overflow occured when performing an integer calculation at compile time");
+					return ErrorExpression::getInstance();
+				}
 			}
 		} 
 		else if(isComparisonOperation(op)){ 
@@ -83,7 +83,7 @@ Node* Optimizer::inlineCall(Function* function,Node* parameters){
 #endif
 
 	BlockExpression* wrapper = new BlockExpression();
-	wrapper->scope->parent   = currentScope;
+	wrapper->scope->changeParent(currentScope);
 	wrapper->setFlag(BlockExpression::RETURNS_LAST_EXPRESSION);
 	wrapper->_location = parameters->location();
 	wrapper->setFlag(Node::RESOLVED);
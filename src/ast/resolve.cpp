@@ -1,5 +1,6 @@
 #include "../base/symbol.h"
 #include "../base/bigint.h"
+#include "../base/threadpool.h"
 #include "../compiler.h"
 #include "scope.h"
 #include "node.h"
@@ -38,64 +39,41 @@ struct SearchResult {
 
 OverloadRange::OverloadRange(Scope* scope,SymbolID function,bool dotSyntax){
 	funcCurr        = nullptr;
-	distance = 0;
-	this->scope     = scope;
-	adjacentScope = nullptr;
-	importsCurr     = nullptr;
+	auto scopes     = scope->visibleScopes();
+	scopesCurr      = scopes.begin;
+	scopesEnd       = scopes.end;
 	this->functionName = function;
 	this->dotSyntax = dotSyntax;
 	getNextFuncIterators();
-}
-void OverloadRange::nextScope(){
-	if(!importsCurr){
-		distance++;
-		//check imported scopes
-		if(!scope->imports.size()){
-			distance++;
-			if(scope->parent2) adjacentScope = scope->parent2;
-			scope = scope->parent;
-		}
-		else {
-			importsCurr = scope->imports.begin()._Ptr;
-			importsEnd  = scope->imports.end()._Ptr;
-			prevScope = scope;
-			scope = *importsCurr;
-		}
-	}
-	else {
-		importsCurr++;
-		if(importsCurr >= importsEnd){
-			distance++;
-			assert(!prevScope->parent2);//NB: the generate function container doens't import anything
-			if(!prevScope->parent && adjacentScope){
-				distance++;
-				scope = adjacentScope;
-				adjacentScope = nullptr;
-			}
-			else scope = prevScope->parent;
-			importsCurr = nullptr;
-		}
-		else scope = *importsCurr;
-	}
+	if(!isEmpty() && !isVisible()) advance();
 }
 void OverloadRange::getNextFuncIterators(){
-	do {
-		if(auto overloadset = scope->containsOverloadset(functionName)){
+	compiler::SharedStateLock lock;
+	for(;scopesCurr != scopesEnd;scopesCurr++){
+		if(auto overloadset = scopesCurr->scope->containsOverloadset(functionName)){
+			if(overloadset->functions.empty()) continue;
+			//The concurrently resolved bodies can add overloads to the set, so the range iterates over a copy
+			if(compiler::concurrentResolution){
+				snapshot.assign(overloadset->functions.begin(),overloadset->functions.end());
+				funcCurr = &snapshot[0];
+				funcEnd  = funcCurr + snapshot.size();
+				return;
+			}
 			funcCurr = overloadset->functions.begin()._Ptr;
 			funcEnd  = overloadset->functions.end()._Ptr;
 			return;
 		}
-		nextScope();
-	} while(scope);
+	}
 }
 void OverloadRange::advance(){
-	funcCurr++;
-	if(funcCurr >= funcEnd){
-		nextScope();
-		if(scope) getNextFuncIterators();
-	}
 	//Only allow functions with 'public' visibility from imported scopes
-	if(importsCurr && scope && (!(*funcCurr)->isPublic())) advance();
+	do {
+		funcCurr++;
+		if(funcCurr >= funcEnd){
+			scopesCurr++;
+			getNextFuncIterators();
+		}
+	} while(!isEmpty() && !isVisible());
 }
 
 /**
@@ -131,6 +109,7 @@ Resolver::Resolver(CompilationUnit* compilationUnit) : _compilationUnit(compilat
 	_currentParent  = nullptr;
 	currentVisibilityMode = data::ast::PUBLIC;
 	_reportUnresolved = false;
+	deferredBodies = nullptr;
 }
 
 /**
@@ -537,7 +516,7 @@ Node* CallExpression::resolve(Resolver* resolver){
 				i.invoke(func,arg);
 				if(auto err = i.result()->asErrorExpression()) return err;
 				auto result = i.result()->asNodeReference()->node();
-				if(auto block = result->asBlockExpression()) block->scope->parent = resolver->currentScope();
+				if(auto block = result->asBlockExpression()) block->scope->changeParent(resolver->currentScope());
 				return resolver->resolve(copyLocationSymbol(result));
 			}
 			else return resolver->executeAndMixinMacro(func,arg);
@@ -557,7 +536,11 @@ Node* CallExpression::resolve(Resolver* resolver){
 				auto result = resolveIS(resolver,this);
 				if(result != this) return result;
 			}
-			else if(arg->isConst()) return resolver->resolve(copyLocationSymbol(evaluateConstantOperation(func->getOperation(),arg)));
+			else if(arg->isConst()){
+				auto result = evaluateConstantOperation(func->getOperation(),arg);
+				if(result->asErrorExpression()) return result;//The shared error node keeps no location
+				return resolver->resolve(copyLocationSymbol(result));
+			}
 		}
 		
 		if(functionJustFound) object = resolver->resolve(new FunctionReference(func));
@@ -891,7 +874,7 @@ static Node* simplifyBlock(BlockExpression* block){
 	if(block->size() == 1 && block->scope->numberOfDefinitions() == 0){
 		auto expr = *(block->begin());
 		if(auto innerBlock = expr->asBlockExpression())
-			innerBlock->scope->parent = block->scope->parent;//NB: { inlined: { var arg = 1; arg + 3 } } -> inlined: { var arg = 1; arg + 3 } 
+			innerBlock->scope->changeParent(block->scope->parent);//NB: { inlined: { var arg = 1; arg + 3 } } -> inlined: { var arg = 1; arg + 3 } 
 		return expr;
 	}
 	return block;
@@ -1298,7 +1281,7 @@ std::pair<Function*,Function*> Record::createFieldGetterSetter(Location location
 	//getter
 	auto getter = new Function(field->name,location);
 	auto gthis = new Argument("self",location,getter);
-	gthis->type.unresolvedExpression = new TypeReference(new Type(Type::POINTER,this));
+	gthis->type.unresolvedExpression = new TypeReference(Type::getPointerType(this));
 	gthis->type.kind = TypePatternUnresolvedExpression::UNRESOLVED;
 	getter->addArgument(gthis);
 	getter->makeFieldAccess(fieldID);
@@ -1306,7 +1289,7 @@ std::pair<Function*,Function*> Record::createFieldGetterSetter(Location location
 	//setter
 	auto setter = new Function(field->name,location);
 	auto sthis  = new Argument("self",location,setter);
-	sthis->type.unresolvedExpression = new TypeReference(new Type(Type::POINTER,this));
+	sthis->type.unresolvedExpression = new TypeReference(Type::getPointerType(this));
 	sthis->type.kind = TypePatternUnresolvedExpression::UNRESOLVED;
 	setter->addArgument(sthis);
 	auto value = new Argument("value",location,setter);
@@ -1421,10 +1404,10 @@ bool Trait::verify(){
 				SymbolID paramName;
 				for(auto defs = templateDeclaration->prefixDefinitions.begin();defs != templateDeclaration->prefixDefinitions.end();++defs){
 					//NB: unecessary creation!
-					if(auto node = defs->second->createReference()){
+					if(auto node = defs->value->createReference()){
 						auto p = node->asTraitParameterReference();
 						if(p->index == i){
-							paramName = defs->first;
+							paramName = defs->key;
 							break;
 						}
 					}
@@ -1443,7 +1426,7 @@ DeclaredType* Trait::resolve(Resolver* resolver){
 	resolver->currentTrait = this;
 
 	if(templateDeclaration){
-		templateDeclaration->parent = resolver->currentScope();
+		templateDeclaration->changeParent(resolver->currentScope());
 		resolver->currentScope(templateDeclaration);
 	}
 
@@ -1567,7 +1550,7 @@ Node* TypeDeclaration::resolve(Resolver* resolver){
 				self->specifyType(Type::getPointerType(_type));
 				destructor->addArgument(self);
 				destructor->_returnType.specify(intrinsics::types::Void);
-				destructor->body.scope->parent = resolver->currentScope();
+				destructor->body.scope->changeParent(resolver->currentScope());
 				resolver->currentParentNode()->asBlockExpression()->addChildPotentiallyDisturbingIteration(destructor);
 			}
 			record->destructor = destructor;
@@ -1687,6 +1670,14 @@ Node* Function::resolve(Resolver* resolver){
 	}
 	//resolve body.
 	if(!body.isResolved()){
+		//Only the signatures of the module's functions are needed to resolve the rest of the module,
+		//so their bodies can be resolved on the thread pool afterwards. The body is analyzed once it's resolved.
+		if(resolver->deferredBodies && parentNode == resolver->compilationUnit()->moduleBody && _returnType.isResolved() && !hasNoBody() &&
+			!isIntrinsic() && !isFlagSet(MACRO_FUNCTION) && !isFlagSet(CONSTRAINT_FUNCTION) && !isFlagSet(INTERPRET_ONLY_INSIDE)){
+			setFlag(Node::RESOLVED);
+			resolver->deferredBodies->push_back(this);
+			return this;
+		}
 		auto oldParent = resolver->currentParentNode();
 		resolver->currentParentNode(this);
 		resolver->resolve(&body);
@@ -1763,15 +1754,88 @@ Node* Resolver::multipassResolve(Node* node,bool quasi){
 
 void optimizeModule(Node* node);
 
-//Multi-pass module resolver
-void  Resolver::resolveModule(BlockExpression* module){
-	_currentParent = nullptr;
-	currentVisibilityMode = data::ast::PUBLIC;
-	whereStack.clear();
+//Resolves the body of a function on the thread pool's worker
+bool Resolver::resolveFunctionBody(Function* function){
+	currentScope(function->owner());
+	currentParentNode(function);
+	currentFunction = function;
+	multipassResolve(&function->body);
+	return function->body.isResolved();
+}
+
+namespace {
+	struct DeferredBody {
+		CompilationUnit* compilationUnit;
+		memory::Region* region;
+		Function* function;
+		std::ostringstream* diagnostics;
+		bool resolved;
+	};
+	void resolveDeferredBody(void* argument){
+		auto body = (DeferredBody*)argument;
+		auto prevRegion = memory::setCurrentRegion(body->region);
+		compiler::bufferDiagnostics(body->diagnostics);
+		Resolver resolver(body->compilationUnit);
+		body->resolved = resolver.resolveFunctionBody(body->function);
+		compiler::bufferDiagnostics(nullptr);
+		memory::setCurrentRegion(prevRegion);
+	}
+	ThreadPool& resolutionPool(){
+		static ThreadPool pool(compiler::resolveThreads);
+		return pool;
+	}
+}
+
+/**
+* Every body gets its own resolver, which shares the module's scopes, the interned types and the specializations with
+* the other resolvers under the shared state lock. The module's region and the global region are shared while the bodies
+* are resolved. The bodies which can't be resolved yet are left to the following serial passes.
+* The diagnostics of each body are buffered and printed in the order of the bodies, so they don't depend on the scheduling.
+*/
+void Resolver::resolveDeferredBodies(BlockExpression* module,std::vector<Function*>& functions){
+	std::vector<DeferredBody> bodies(functions.size());
+	std::vector<std::ostringstream> diagnostics(functions.size());
+	auto region = memory::currentRegion();
+	for(size_t i = 0;i<functions.size();i++){
+		bodies[i].compilationUnit = compilationUnit();
+		bodies[i].region   = region;
+		bodies[i].function = functions[i];
+		bodies[i].diagnostics = &diagnostics[i];
+		bodies[i].resolved = false;
+	}
+
+	auto& pool = resolutionPool();
+	region->setShared(true);
+	memory::globalRegion()->setShared(true);
+	compiler::concurrentResolution = true;
+	for(auto i = bodies.begin();i!=bodies.end();++i) pool.add(&resolveDeferredBody,&(*i));
+	pool.wait();
+	compiler::concurrentResolution = false;
+	memory::globalRegion()->setShared(false);
+	region->setShared(false);
+	for(auto i = diagnostics.begin();i!=diagnostics.end();++i){
+		auto output = (*i).str();
+		if(!output.empty()) System::print(output);
+	}
+
+	//The bodies are analyzed in the order of their declarations, so the analysis doesn't depend on the scheduling
+	for(auto i = bodies.begin();i!=bodies.end();++i){
+		if((*i).resolved){
+#ifdef DATA_STAT_COLLECT_STATISTICS
+			compiler::statistics.bodiesResolvedConcurrently++;
+#endif
+			analyze(&(*i).function->body,(*i).function);
+		}
+		else {
+			(*i).function->flags &= ~Node::RESOLVED;
+			module->flags &= ~Node::RESOLVED;
+		}
+	}
+}
 
+void Resolver::resolvePasses(BlockExpression* module){
 	size_t prevUnresolvedExpressions;
 	unresolvedExpressions = 0xDEADBEEF;
-	_pass = 1;
 	do{
 		prevUnresolvedExpressions = unresolvedExpressions;
 		unresolvedExpressions = 0;
@@ -1782,6 +1846,29 @@ void  Resolver::resolveModule(BlockExpression* module){
 		_pass++;
 	}
 	while(prevUnresolvedExpressions != unresolvedExpressions && unresolvedExpressions != 0);
+}
+
+//Multi-pass module resolver
+void  Resolver::resolveModule(BlockExpression* module){
+	_currentParent = nullptr;
+	currentVisibilityMode = data::ast::PUBLIC;
+	whereStack.clear();
+	_pass = 1;
+
+	//With several resolution threads the declarations and the signatures are resolved first,
+	//and the bodies of the module's functions are resolved concurrently afterwards
+	std::vector<Function*> deferred;
+	if(compiler::resolveThreads > 1) deferredBodies = &deferred;
+	resolvePasses(module);
+	deferredBodies = nullptr;
+	if(!deferred.empty()){
+#ifdef DATA_STAT_COLLECT_STATISTICS
+		compiler::statistics.bodiesDeferred += deferred.size();
+#endif
+		resolveDeferredBodies(module,deferred);
+		resolvePasses(module);
+	}
+
 	if(unresolvedExpressions > 0 && !module->isResolved()){
 		reportUnresolvedNodes(module);
 		return;
@@ -1800,13 +1887,6 @@ Node* Resolver::resolveMacroAtParseStage(Node* macro){
 	return multipassResolve(macro);
 }
 
-Node* Resolver::executeAndMixinMacro(Function* function,Node* arg){
-	CTFEinvocation i(compilationUnit(),function);
-	if(i.invoke(arg)) return mixinMacro(&i,currentScope());
-	error(arg,"Failed to interpret a macro '%s' at compile time!",function->label());
-	return ErrorExpression::getInstance();
-}
-
 /**
 * Mixining the expression inside the [> <] obtained from macro invocation.
 * Scenarios: mixin( [> 1 <] ) => 
@@ -1815,19 +1895,248 @@ Node* Resolver::executeAndMixinMacro(Function* function,Node* arg){
 				{ var x = 2 ; 2 } using parent scope, returning 2
 				The mixined block will use the parent scope to define x, and will return the result of the last expression - i.e. 2
 */
+static Node* mixinExpansion(Node* inside,DuplicationModifiers* mods){
+	if(auto block = inside->asBlockExpression()){
+		auto size = block->size();
+		if(size == 0) return new UnitExpression;
+		else if(size == 1) return (*block->begin())->duplicate(mods);
+		else return block->duplicateMixin(mods);
+	}
+	return inside->duplicate(mods);
+}
+/**
+* Collects the values which are spliced into a quasi-quote. A spliced value can be another quasi-quote which was stored
+* into a macro's variable(e.g. collection = [> Iota($begin,$end) <]), so its splice points are collected as well.
+* Returns false if a spliced node reference doesn't know its splice points.
+*/
+typedef std::vector<std::pair<Variable*,Node*> > SplicedValues;
+static bool collectSplices(CTFEinvocation* invocation,NodeReference::Splices* splices,SplicedValues& values){
+	bool complete = true;
+	for(auto i = splices->variables.begin();i!=splices->variables.end();++i){
+		auto value = invocation->getValue(*i);
+		if(!value) continue;
+		auto collected = values.begin();
+		for(;collected!=values.end();++collected){
+			if(collected->first == *i) break;
+		}
+		if(collected != values.end()) continue;
+		values.push_back(std::make_pair(*i,value));
+		if(auto noderef = value->asNodeReference()){
+			if(!noderef->splices()) complete = false;
+			else if(!collectSplices(invocation,noderef->splices(),values)) complete = false;
+		}
+	}
+	return complete;
+}
+
 Node* mixinMacro(CTFEinvocation* invocation,Scope* scope){
 	DuplicationModifiers mods(scope);
-	mods.expandedMacroOptimization = invocation;
-	Node* resultingExpression;
 	auto  noderef = invocation->result()->asNodeReference();
-	auto  inside  = noderef->node();
-	if(auto block = inside->asBlockExpression()){
-		auto size = block->size();
-		if(size == 0) resultingExpression = new UnitExpression;
-		else if(size == 1) resultingExpression = (*block->begin())->duplicate(&mods);
-		else resultingExpression = block->duplicateMixin(&mods);
-	} else resultingExpression = inside->duplicate(&mods);
-	return resultingExpression;
+	//A quasi-quote knows its splice points, otherwise every variable reference is checked for a value
+	SplicedValues values;
+	if(!noderef->splices() || !collectSplices(invocation,noderef->splices(),values)) mods.expandedMacroOptimization = invocation;
+	for(auto i = values.begin();i!=values.end();++i) mods.splice(i->first,i->second);
+	return mixinExpansion(noderef->node(),&mods);
+}
+
+/**
+* The expansion cache of the pure macros.
+* A pure macro which is invoked with the same constant arguments returns the same quasi-quote with the same spliced values,
+* so the repeated invocations skip the interpretation and mix in a duplicate of the recorded expansion.
+* The macros which read the tokens using the parser API don't take any arguments and are never memoized.
+*/
+namespace {
+	struct MacroExpansion {
+		Function* function;
+		std::vector<Node*> arguments;
+		NodeReference* result;
+		SplicedValues splices;
+		size_t hits;
+	};
+	HashMap<size_t,std::vector<MacroExpansion*> > macroExpansions;
+
+	//Returns false if the argument can't be compared structurally
+	bool hashConstant(Node* node,size_t& hash){
+		size_t kind,value;
+		if(auto integer = node->asIntegerLiteral()){
+			kind  = 1;
+			value = integer->integer.wordCount == 1? size_t(integer->integer.u64) : size_t(integer->integer.wordCount);
+		}
+		else if(auto fp = node->asFloatingPointLiteral()){
+			kind  = 2;
+			uint64 bits;
+			memcpy(&bits,&fp->value,sizeof(bits));
+			value = size_t(bits ^ (bits >> 32));
+		}
+		else if(auto c = node->asCharacterLiteral()){
+			kind  = 3;
+			value = size_t(c->value);
+		}
+		else if(auto b = node->asBoolExpression()){
+			kind  = 4;
+			value = b->value? 1 : 0;
+		}
+		else if(auto str = node->asStringLiteral()){
+			kind  = 5;
+			value = str->block.length();
+			for(size_t i = 0;i<str->block.length();i++) value = hashing::combine(value,size_t(str->block.ptr()[i]));
+		}
+		else if(auto typeref = node->asTypeReference()){
+			kind  = 6;
+			value = size_t(typeref->type->type);
+		}
+		else if(node->asUnitExpression()){
+			kind  = 7;
+			value = 0;
+		}
+		else return false;
+		hash = hashing::combine(hash,hashing::combine(kind,value));
+		return true;
+	}
+	bool hashMacroArguments(Function* function,Node* arg,std::vector<Node*>& arguments,size_t& hash){
+		hash = hashing::Hasher<Function*>::hash(function);
+		if(auto tuple = arg->asTupleExpression()) arguments.assign(tuple->begin(),tuple->end());
+		else arguments.push_back(arg);
+		for(auto i = arguments.begin();i!=arguments.end();++i){
+			if(!(*i)->isConst() || !hashConstant(*i,hash)) return false;
+		}
+		return true;
+	}
+	MacroExpansion* findMacroExpansion(Function* function,const std::vector<Node*>& arguments,size_t hash){
+		auto expansions = macroExpansions.find(hash);
+		if(!expansions) return nullptr;
+		for(auto i = expansions->begin();i!=expansions->end();++i){
+			auto expansion = *i;
+			if(expansion->function != function || expansion->arguments.size() != arguments.size()) continue;
+			size_t j = 0;
+			for(;j<arguments.size();j++){
+				auto recorded = expansion->arguments[j];
+				if(!recorded->isSame(arguments[j]) || !recorded->returnType()->isSame(arguments[j]->returnType())) break;
+			}
+			if(j == arguments.size()) return expansion;
+		}
+		return nullptr;
+	}
+	//Only the quasi-quotes which know their splice points(the nested ones too) can be recorded, as the other expansions need the invocation's registers
+	void recordMacroExpansion(Function* function,std::vector<Node*>& arguments,size_t hash,CTFEinvocation* invocation){
+		auto noderef = invocation->result()->asNodeReference();
+		if(!noderef || !noderef->splices()) return;
+		SplicedValues splices;
+		if(!collectSplices(invocation,noderef->splices(),splices)) return;
+		auto expansion = new MacroExpansion;
+		expansion->function = function;
+		expansion->arguments.swap(arguments);
+		expansion->result = noderef;
+		expansion->splices.swap(splices);
+		expansion->hits = 0;
+		macroExpansions[hash].push_back(expansion);
+	}
+	/**
+	* The recorded arguments are spliced as the arguments of the current invocation, and the other constant values are
+	* duplicated with the current invocation's location, so a reused expansion is the same as an interpreted one.
+	*/
+	void spliceMacroExpansion(MacroExpansion* expansion,const std::vector<Node*>& arguments,Node* arg,DuplicationModifiers* mods){
+		for(auto i = expansion->splices.begin();i!=expansion->splices.end();++i){
+			auto value = i->second;
+			size_t j = 0;
+			for(;j<arguments.size();j++){
+				if(expansion->arguments[j] == value) break;
+			}
+			if(j < arguments.size()) value = arguments[j];
+			else if(!value->asNodeReference()){
+				value = value->duplicate(mods);
+				value->_location = arg->location();
+			}
+			mods->splice(i->first,value);
+		}
+	}
+}
+
+void dumpMacroExpansionStatistics(){
+	HashMap<Function*,size_t> hits;
+	for(auto i = macroExpansions.begin();i!=macroExpansions.end();++i){
+		for(auto j = i->value.begin();j!=i->value.end();++j){
+			if((*j)->hits) hits[(*j)->function] += (*j)->hits;
+		}
+	}
+	for(auto i = hits.begin();i!=hits.end();++i)
+		System::debugPrint(format("Expansions of the macro '%s' reused from the cache: %s.",i->key->label(),i->value));
+}
+
+Node* Resolver::executeAndMixinMacro(Function* function,Node* arg){
+	std::vector<Node*> arguments;
+	size_t hash;
+	bool memoize = compiler::memoizeMacros && function->isFlagSet(Function::PURE) && hashMacroArguments(function,arg,arguments,hash);
+	if(memoize){
+		MacroExpansion* expansion;
+		{
+			//The recorded expansions are never changed, so they are duplicated outside of the lock
+			compiler::SharedStateLock lock;
+			expansion = findMacroExpansion(function,arguments,hash);
+			if(expansion){
+				expansion->hits++;
+#ifdef DATA_STAT_COLLECT_STATISTICS
+				compiler::statistics.macroExpansionCacheHits++;
+#endif
+			}
+		}
+		if(expansion){
+			DuplicationModifiers mods(currentScope());
+			spliceMacroExpansion(expansion,arguments,arg,&mods);
+			return mixinExpansion(expansion->result->node(),&mods);
+		}
+	}
+	CTFEinvocation i(compilationUnit(),function);
+	if(i.invoke(arg)){
+		if(memoize){
+			compiler::SharedStateLock lock;
+#ifdef DATA_STAT_COLLECT_STATISTICS
+			compiler::statistics.macroExpansionsMemoized++;
+#endif
+			recordMacroExpansion(function,arguments,hash,&i);
+		}
+		return mixinMacro(&i,currentScope());
+	}
+	error(arg,"Failed to interpret a macro '%s' at compile time!",function->label());
+	return ErrorExpression::getInstance();
+}
+
+/**
+*  The specializations are indexed by a hash of the usage scope, the types of the pattern parameters and the values
+*  of the expanded parameters. A specialization whose expanded values can't be hashed is left out of the index,
+*  as such values aren't equal to anything under isSame anyway.
+*  The types are hashed structurally, as the anonymous records and the node types aren't unique.
+*/
+struct Function::SpecializationIndex {
+	HashMap<size_t,std::vector<Function*> > functions;
+	size_t indexed;//The number of the generated functions which were added to the index
+};
+namespace {
+	inline void hashSpecializedType(Type* type,size_t& hash){
+		hash = hashing::combine(hash,type->structuralHash());
+	}
+	bool hashSpecialization(Function* original,Type** specializedParameters,Node** passedExpressions,Scope* usageScope,size_t& hash){
+		hash = hashing::Hasher<Scope*>::hash(usageScope);
+		for(size_t j = 0;j<original->arguments.size();j++){
+			if(original->arguments[j]->expandAtCompileTime()){
+				if(!hashConstant(passedExpressions[j],hash)) return false;
+			}
+			else if(original->arguments[j]->type.isPattern()) hashSpecializedType(specializedParameters[j],hash);
+		}
+		return true;
+	}
+	bool hashSpecialization(Function* original,Function* specialization,Scope* usageScope,size_t& hash){
+		hash = hashing::Hasher<Scope*>::hash(usageScope);
+		size_t expandedParameterOffset = 0;
+		for(size_t j = 0;j<original->arguments.size();j++){
+			if(original->arguments[j]->expandAtCompileTime()){
+				if(!hashConstant(specialization->expandedArguments[expandedParameterOffset],hash)) return false;
+				expandedParameterOffset++;
+			}
+			else if(original->arguments[j]->type.isPattern()) hashSpecializedType(specialization->arguments[j - expandedParameterOffset]->type.type(),hash);
+		}
+		return true;
+	}
 }
 
 /**
@@ -1837,33 +2146,49 @@ Node* mixinMacro(CTFEinvocation* invocation,Scope* scope){
 *  If the original didn't generate the given specialization yet, we generate one and add it to the original's set.
 *
 *  The generated functions will have access to the declaration scope, and the module scope of the user expansion.
-*  TODO: identical specialization reduction!
+*  The specializations which are lowered to identical bodies are folded together by the backend.
 */
 Function* Function::specializationExists(Type** specializedParameters,Node** passedExpressions,Scope* usageScope){
-	auto numberOfParameters= arguments.size();
-	size_t j = 0;
-	for(auto i = generatedFunctions.begin();i!=generatedFunctions.end();i++){
-		auto alreadyGenerated = *i;
-		bool match = true;
-		size_t expandedParameterOffset = 0;
-		if(usageScope && alreadyGenerated->owner()->parent != usageScope) continue;
-		for(j = 0; j<numberOfParameters; j++){
-			if(arguments[j]->expandAtCompileTime()){
-				if(!alreadyGenerated->expandedArguments[expandedParameterOffset]->isSame(passedExpressions[j])){
-					match = false;
-					break;
-				}
-				expandedParameterOffset++;
-			}
-			else if(specializedParameters && !alreadyGenerated->arguments[j - expandedParameterOffset]->type.type()->isSame(specializedParameters[j])){
-				match = false;
-				break;
-			}
+	//The lookups without the specialized types compare only the expanded values, so they can't use the index
+	if(specializedParameters || !isFlagSet(HAS_PATTERN_ARGUMENTS)){
+		if(!specializations){
+			specializations = new SpecializationIndex;
+			specializations->indexed = 0;
+		}
+		//The type templates are looked up without the usage scope
+		for(;specializations->indexed < generatedFunctions.size();specializations->indexed++){
+			auto generated = generatedFunctions[specializations->indexed];
+			size_t hash;
+			if(hashSpecialization(this,generated,isTypeTemplate()? nullptr : generated->owner()->parent,hash))
+				specializations->functions[hash].push_back(generated);
+		}
+		size_t hash;
+		if(!hashSpecialization(this,specializedParameters,passedExpressions,usageScope,hash)) return nullptr;
+		auto candidates = specializations->functions.find(hash);
+		if(!candidates) return nullptr;
+		for(auto i = candidates->begin();i!=candidates->end();i++){
+			if(matchesSpecialization(*i,specializedParameters,passedExpressions,usageScope)) return *i;
 		}
-		if(match) return alreadyGenerated;
+		return nullptr;
+	}
+	for(auto i = generatedFunctions.begin();i!=generatedFunctions.end();i++){
+		if(matchesSpecialization(*i,specializedParameters,passedExpressions,usageScope)) return *i;
 	}
 	return nullptr;
 }
+bool Function::matchesSpecialization(Function* alreadyGenerated,Type** specializedParameters,Node** passedExpressions,Scope* usageScope){
+	if(usageScope && alreadyGenerated->owner()->parent != usageScope) return false;
+	size_t expandedParameterOffset = 0;
+	for(size_t j = 0; j<arguments.size(); j++){
+		if(arguments[j]->expandAtCompileTime()){
+			if(!alreadyGenerated->expandedArguments[expandedParameterOffset]->isSame(passedExpressions[j])) return false;
+			expandedParameterOffset++;
+		}
+		else if(specializedParameters && !alreadyGenerated->arguments[j - expandedParameterOffset]->type.type()->isSame(specializedParameters[j]))
+			return false;
+	}
+	return true;
+}
 
 Argument* Argument::specializedDuplicate(Function* dest,DuplicationModifiers* mods,Type* specializedType,Node* expandedValue){
 	//value expansion
@@ -1892,7 +2217,7 @@ Function* Function::specializedDuplicate(DuplicationModifiers* mods,Type** speci
 
 	debug("Need to duplicate determined function %s!",label());
 	auto func = new Function(label(),location());
-	func->body.scope->parent = mods->target;
+	func->body.scope->changeParent(mods->target);
 	mods->target = func->body.scope;
 	
 	//args
@@ -1919,6 +2244,7 @@ NB: given the situation:
 where the expansion of foo(x *Bar(int32)) can't be resolved straight away, resolve the function from the calling expression
 */
 bool Resolver::resolveSpecialization(Function* function){
+	compiler::SharedStateLock lock;
 	auto original = function->generatedFunctionParent;
 
 	auto oldScope = currentScope();
@@ -1952,6 +2278,8 @@ void introduceFunctionExpansions(Scope* dest,Function* original,Node** passedExp
 }
 
 Function* Resolver::specializeFunction(TypePatternUnresolvedExpression::PatternMatcher& patternMatcher,Function* original,Type** specializedParameters,Node** passedExpressions){
+	//The lookup and the registration of the specialization are atomic, so the bodies which are resolved concurrently share the specializations
+	compiler::SharedStateLock lock;
 	size_t numberOfParameters = original->arguments.size();
 	assert(original->isFlagSet(Function::HAS_PATTERN_ARGUMENTS) || original->isFlagSet(Function::HAS_EXPENDABLE_ARGUMENTS));	
 	
@@ -1995,7 +2323,7 @@ Function* Resolver::specializeFunction(TypePatternUnresolvedExpression::PatternM
 	//specializationWrapper->scope->import(original->owner()); //import the scope in which the original function was defined.
 	//if(usageScope) 
 	specializationWrapper->scope->setParent(usageScope);//import the usage scope
-	specializationWrapper->scope->parent2 = declarationScope;
+	specializationWrapper->scope->setParent2(declarationScope);
 	//duplicate the original
 	DuplicationModifiers mods(specializationWrapper->scope);
 	auto specialization = original->specializedDuplicate(&mods,specializedParameters,passedExpressions);
@@ -2143,8 +2471,7 @@ Node* Resolver::constructFittingArgument(Function** function,Node *arg,bool depe
 		DuplicationModifiers mods(func->body.scope);
 		for(size_t i = 0;i< result.size();i++){
 			if(!func->arguments[i]->isDependent()){
-				mods.redirectors[reinterpret_cast<void*>(static_cast<Variable*>(func->arguments[i]))] =
-					std::make_pair(reinterpret_cast<void*>(result[i]),true);
+				mods.expandArgument(func->arguments[i],result[i]);
 			}
 		}
 
@@ -2224,7 +2551,8 @@ Node* Resolver::constructFittingArgument(Function** function,Node *arg,bool depe
 *	f(1,2) matches f(x)
 *	f(1,2,3) matches f(x,y)
 */
-bool match(Resolver* evaluator,Function* func,Node* arg,int& weight){
+//notAllResolved is set when a pattern wasn't matched because some of the types it checks aren't resolved yet.
+bool match(Resolver* evaluator,Function* func,Node* arg,int& weight,bool& notAllResolved){
 	//Weights
 	enum {
 		WILDCARD = 1,
@@ -2276,7 +2604,10 @@ bool match(Resolver* evaluator,Function* func,Node* arg,int& weight){
 						fields.push_back(field);
 					}
 					auto record = AnonymousAggregate::create(&fields[0],fields.size());
-					if(!matcher.match(record,pattern)) return false;
+					if(!matcher.match(record,pattern)){
+						if(matcher.notAllResolvedMatch) notAllResolved = true;
+						return false;
+					}
 				}
 			}
 			else {
@@ -2322,7 +2653,10 @@ bool match(Resolver* evaluator,Function* func,Node* arg,int& weight){
 		}
 		else if( func->arguments[currentArg]->type.isPattern() ){
 			if(auto pattern = func->arguments[currentArg]->type.pattern){
-				if(!matcher.matchWithSubtyping(exprBegin[currentExpr]->returnType(),pattern,getSpecializationScope(func,evaluator),Type::AllowAutoAddressof)) return false;
+				if(!matcher.matchWithSubtyping(exprBegin[currentExpr]->returnType(),pattern,getSpecializationScope(func,evaluator),Type::AllowAutoAddressof)){
+					if(matcher.notAllResolvedMatch) notAllResolved = true;
+					return false;
+				}
 				weight += WILDCARD + 1;
 			}
 			else weight += WILDCARD;
@@ -2355,6 +2689,119 @@ bool match(Resolver* evaluator,Function* func,Node* arg,int& weight){
 	return result; 
 }
 
+/**
+* The overload resolution cache.
+* The overload which is picked for a call depends only on the overload sets which are visible from the calling scope,
+* and on the types, labels and constness of the arguments. The key identifies the visible overload sets by their order
+* and by the rank of their distance, so the calls from the different functions of a module share the cached results.
+* The calls with untyped literals or tuples inside the arguments aren't cached, as their matching looks at the values.
+* The results for a function name are discarded when a new overload with that name is defined.
+* The argument types are compared structurally, as the anonymous records and the node types aren't unique.
+*/
+namespace overloads {
+	struct Signature {
+		std::vector<size_t> values;
+		std::vector<Type*>  types;
+
+		bool operator == (const Signature& other) const {
+			if(values != other.values || types.size() != other.types.size()) return false;
+			for(size_t i = 0;i<types.size();i++){
+				if(!types[i]->isSame(other.types[i])) return false;
+			}
+			return true;
+		}
+	};
+	struct CachedResolution {
+		Signature key;
+		Function* function;//null when no overload matches
+	};
+	typedef HashMap<size_t,std::vector<CachedResolution> > Resolutions;
+	static HashMap<SymbolID,Resolutions*> cache;
+	static HashMap<SymbolID,size_t> generations;
+
+	void invalidate(SymbolID function){
+		compiler::SharedStateLock lock;
+		generations[function]++;
+		if(auto resolutions = cache.find(function)) (*resolutions)->clear();
+	}
+	size_t generation(SymbolID function){
+		compiler::SharedStateLock lock;
+		auto result = generations.find(function);
+		return result? *result : 0;
+	}
+
+	static bool signature(Resolver* resolver,Scope* scope,SymbolID function,Node* arg,bool dotSyntax,Signature& signature){
+		auto& key = signature.values;
+		key.push_back(reinterpret_cast<size_t>(resolver->compilationUnit()->moduleBody->scope));//The specialization scope
+		key.push_back(dotSyntax? 1 : 0);
+		auto scopes = scope->visibleScopes();
+		int lastDistance = -1;
+		size_t rank = 0;
+		for(auto i = scopes.begin;i!=scopes.end;++i){
+			auto overloadset = i->scope->containsOverloadset(function);
+			if(!overloadset || overloadset->functions.empty()) continue;
+			if(i->distance != lastDistance){
+				rank++;
+				lastDistance = i->distance;
+			}
+			key.push_back(reinterpret_cast<size_t>(overloadset));
+			key.push_back(rank*2 + (i->imported? 1 : 0));
+		}
+		key.push_back(size_t(-1));
+
+		Node** exprBegin = &arg;
+		size_t expressionCount = 1;
+		if(auto tuple = arg->asTupleExpression()){
+			exprBegin = tuple->childrenPtr();
+			expressionCount = tuple->size();
+		}
+		else if(arg->asUnitExpression()) expressionCount = 0;
+		key.push_back(arg->asTupleExpression()? 1 : 0);
+		for(size_t i = 0;i<expressionCount;i++){
+			auto expr = exprBegin[i];
+			if(expr->asTupleExpression() || expr->isUntypedLiteral()) return false;
+			//Variant options are matched by the referenced type
+			if(auto tref = expr->asTypeReference()) signature.types.push_back(tref->type);
+			signature.types.push_back(expr->returnType());
+			key.push_back(expr->asTypeReference()? 1 : 0);
+			key.push_back(expr->label().isNull()? 0 : reinterpret_cast<size_t>(expr->label().ptr()));
+			key.push_back(expr->isConst()? 1 : 0);
+		}
+		return true;
+	}
+	static size_t hash(const Signature& key){
+		size_t result = key.values.size();
+		for(auto i = key.values.begin();i!=key.values.end();++i) result = hashing::combine(result,hashing::mix(*i));
+		for(auto i = key.types.begin();i!=key.types.end();++i) result = hashing::combine(result,(*i)->structuralHash());
+		return result;
+	}
+	static bool find(SymbolID function,const Signature& key,size_t keyHash,Function*& result){
+		auto resolutions = cache.find(function);
+		if(!resolutions) return false;
+		auto entries = (*resolutions)->find(keyHash);
+		if(!entries) return false;
+		for(auto i = entries->begin();i!=entries->end();++i){
+			if((*i).key == key){
+				result = (*i).function;
+				return true;
+			}
+		}
+		return false;
+	}
+	//The result isn't cached when an overload was defined after the cache was probed, as the result may be outdated
+	static void insert(SymbolID function,size_t probedGeneration,Signature& key,size_t keyHash,Function* result){
+		compiler::SharedStateLock lock;
+		if(generation(function) != probedGeneration) return;
+		auto& resolutions = cache[function];
+		if(!resolutions) resolutions = new Resolutions;
+		CachedResolution entry;
+		entry.key.values.swap(key.values);
+		entry.key.types.swap(key.types);
+		entry.function = result;
+		(*resolutions)[keyHash].push_back(entry);
+	}
+}
+
 // TODO explicitImport.foo <- need to limit this access to public 
 // TODO import qualified foo; var x foo.Foo ; foo.method() <-- FIX use dot syntax
 // TODO: recurive calls
@@ -2367,6 +2814,32 @@ Function* Resolver::resolveFunctionCall(Scope* scope,SymbolID function,Node** pa
 	Function* foundOverload = nullptr;
 	bool multipleOverload = false;
 
+	overloads::Signature key;
+	size_t keyHash = 0;
+	bool cacheable,cached = false;
+	size_t generation = 0;
+	bool notAllResolved = false;//Some candidate couldn't be matched yet, so a miss mustn't be cached
+	{
+		//Only the cache is accessed under the lock, the overloads are matched concurrently
+		compiler::SharedStateLock lock;
+#ifdef DATA_STAT_COLLECT_STATISTICS
+		compiler::statistics.overloadResolutions++;
+#endif
+		cacheable = !reportMultipleOverloads && overloads::signature(this,scope,function,arg,dotSyntax,key);
+		if(cacheable){
+			keyHash = overloads::hash(key);
+			generation = overloads::generation(function);
+			cached  = overloads::find(function,key,keyHash,foundOverload);
+#ifdef DATA_STAT_COLLECT_STATISTICS
+			if(cached) compiler::statistics.overloadResolutionCacheHits++;
+#endif
+		}
+	}
+	if(cached){
+		if(foundOverload) *parameter = this->constructFittingArgument(&foundOverload,arg);
+		return foundOverload;
+	}
+
 	//Iterate over all the overloads picking the closest one with the best weight.
 	for(overloads::OverloadRange overload(scope,function,dotSyntax);!overload.isEmpty();overload.advance()){
 		//Return the closest overload
@@ -2375,7 +2848,7 @@ Function* Resolver::resolveFunctionCall(Scope* scope,SymbolID function,Node** pa
 		//TODO: recurive calls
 		if(!overload.currentFunction()->areArgumentsResolved()) return nullptr;
 
-		if(match(this,overload.currentFunction(),arg,weight)){
+		if(match(this,overload.currentFunction(),arg,weight,notAllResolved)){
 
 			if(weight > maxWeight){
 				foundOverload = overload.currentFunction();
@@ -2395,6 +2868,7 @@ Function* Resolver::resolveFunctionCall(Scope* scope,SymbolID function,Node** pa
 	}
 
 	if(multipleOverload && !reportMultipleOverloads) resolveFunctionCall(scope,function,parameter,dotSyntax,true);
+	else if(cacheable && !notAllResolved) overloads::insert(function,generation,key,keyHash,foundOverload);
 	if(foundOverload){
 		*parameter = this->constructFittingArgument(&foundOverload,arg);
 	}
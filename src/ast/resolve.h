@@ -28,6 +28,7 @@ public:
 	Function* currentFunction; // The function we are currently resolving. Can be null.
 	data::ast::VisibilityMode currentVisibilityMode;
 	std::vector<ScopedCommand*> whereStack;
+	std::vector<Function*>* deferredBodies; //When set, the bodies of the module's functions are left to be resolved after the declarations
 
 	//Varios stages.
 	inline bool isReportingUnresolvedNodes() { return _reportUnresolved; }
@@ -54,6 +55,9 @@ public:
 	// Resolves expressions and definitions in a module using multiple passes
 	void resolveModule(BlockExpression* module);
 
+	// Resolves the body of a module's function which was deferred until the declarations were resolved
+	bool resolveFunctionBody(Function* function);
+
 	//Attempt to resolve macroes when they are defined, so that we can use them straight away
 	Node* resolveMacroAtParseStage(Node* macro);
 
@@ -98,6 +102,9 @@ private:
 	Node* reportUnresolvedNode(Node* node);
 
 	void reportUnresolvedNodes(Node* root);
+
+	void resolvePasses(BlockExpression* module);
+	void resolveDeferredBodies(BlockExpression* module,std::vector<Function*>& functions);
 };
 
 namespace overloads {
@@ -110,28 +117,33 @@ struct OverloadRange {
 private:
 	Function** funcCurr;
 	Function** funcEnd;
-	int distance;
-	Scope*  scope;
-	Scope*  prevScope;
-	Scope*  adjacentScope;
-	Scope** importsCurr; //import iterators
-	Scope** importsEnd;
+	const Scope::VisibleScope* scopesCurr;
+	const Scope::VisibleScope* scopesEnd;
 	SymbolID functionName;
 	bool    dotSyntax;
+	std::vector<Function*> snapshot; //A copy of the current overload set while the bodies are resolved concurrently
 	
-	void nextScope();
 	void getNextFuncIterators();
+	inline bool isVisible(){ return !scopesCurr->imported || (*funcCurr)->isPublic(); }
 public:
 
-	inline bool isEmpty(){ return scope == nullptr; }
+	inline bool isEmpty(){ return scopesCurr == scopesEnd; }
 	inline Function* currentFunction(){ return *funcCurr; }
 	void   advance();
-	inline int currentDistance(){ return distance; }
+	inline int currentDistance(){ return scopesCurr->distance; }
 
 };
 
+//Discards the cached overload resolutions for the given function name, called when a new overload is defined.
+void invalidate(SymbolID function);
+//Changes whenever a new overload with the given name is defined.
+size_t generation(SymbolID function);
+
 }
 
 Node* mixinMacro(CTFEinvocation* invocation,Scope* scope);
 
+//Prints the number of the expansions which were reused from the cache for each memoized macro
+void dumpMacroExpansionStatistics();
+
 #endif
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "../base/symbol.h"
 #include "../base/bigint.h"
 #include "../base/system.h"
+#include "../base/threadpool.h"
 #include "../compiler.h"
 #include "scope.h"
 #include "node.h"
@@ -9,16 +10,53 @@
 #include "../intrinsics/types.h"
 
 
+size_t Scope::structureGeneration = 1;
+
 Scope::Scope(Scope* parent) : _functionOwner(parent ? parent->_functionOwner : nullptr) {
 	this->parent = parent;
 	parent2 = nullptr;
 	precedenceProperty = nullptr;
 	importsArphaIntrinsic = false;
 	importsArphaExternal = false;
+	visible.begin = visible.end = nullptr;
+	imported.begin = imported.end = nullptr;
+	visibleGeneration = importedGeneration = 0;
+	structureObserved = false;
+	lookupGeneration = 1;
+	resolvedGeneration = 0;
+	definitionsVersion = 0;
+	similarity = nullptr;
 }
 void Scope::setParent(Scope* scope){
+	compiler::SharedStateLock lock;
 	if(!_functionOwner) _functionOwner= scope ? scope->_functionOwner : nullptr;
 	this->parent = scope;
+	structureChanged();
+}
+void Scope::changeParent(Scope* scope){
+	compiler::SharedStateLock lock;
+	this->parent = scope;
+	structureChanged();
+}
+void Scope::setParent2(Scope* scope){
+	compiler::SharedStateLock lock;
+	parent2 = scope;
+	structureChanged();
+}
+//The new scopes are set up before any lookup goes through them, so they don't invalidate anything
+void Scope::structureChanged(){
+	if(structureObserved) structureGeneration++;
+	definitionsChanged();
+}
+//Invalidates the cached lookups of this scope and of the scopes whose cached lookups searched it
+void Scope::definitionsChanged(){
+	definitionsVersion++;
+	lookupGeneration++;
+	for(auto i = lookupObservers.begin();i!=lookupObservers.end();++i) i->key->lookupGeneration++;
+	lookupObservers.clear();
+}
+inline void Scope::observeLookup(Scope* scope){
+	if(scope != this) lookupObservers[scope] = true;
 }
 Scope*   Scope::moduleScope(){
 	if(!parent) return this;
@@ -31,6 +69,7 @@ size_t Scope::numberOfDefinitions() const {
 	return prefixDefinitions.size() + infixDefinitions.size();
 }
 void Scope::import(Scope* scope,const char* alias,bool qualified,bool exported){
+	compiler::SharedStateLock lock;
 	//alias in a form of single file
 	const char* path = alias;
 	ImportedScope* importTree = nullptr;
@@ -84,28 +123,115 @@ void Scope::import(Scope* scope,const char* alias,bool qualified,bool exported){
 		debug("defining public import %s",alias);
 		exportedImports.push_back(std::make_pair(scope,std::make_pair(alias,qualified)));
 	}
+	structureChanged();
 }
 void Scope::import(Scope* scope){
+	compiler::SharedStateLock lock;
 	imports.push_back(scope);
+	structureChanged();
 }
 
-#define LOOKUP_IMPORTED(t,c) \
-	auto var = t##Definitions.find(name); \
-	if (var != t##Definitions.end() && (int)var->second->isPublic()) return var->second; \
-	if(parent) return parent->lookupImported##c(name); \
+template<typename T>
+static Scope::Range<const T> copyToRegion(const std::vector<T>& elements){
+	auto data = (T*)memory::allocate(sizeof(T)*elements.size());
+	std::copy(elements.begin(),elements.end(),data);
+	Scope::Range<const T> result = { data,data + elements.size() };
+	return result;
+}
+
+Scope::Range<const Scope::VisibleScope> Scope::visibleScopes(){
+	compiler::SharedStateLock lock;
+	if(visibleGeneration == structureGeneration) return visible;
+	std::vector<VisibleScope> scopes;
+	Scope* scope = this;
+	Scope* adjacentScope = nullptr;
+	int distance = 0;
+	while(scope){
+		scope->structureObserved = true;
+		VisibleScope current = { scope,distance,false };
+		scopes.push_back(current);
+		distance++;
+		if(!scope->imports.size()){
+			distance++;
+			if(scope->parent2) adjacentScope = scope->parent2;
+			scope = scope->parent;
+		}
+		else {
+			for(auto i = scope->imports.begin();i!=scope->imports.end();++i){
+				VisibleScope import = { *i,distance,true };
+				scopes.push_back(import);
+			}
+			distance++;
+			assert(!scope->parent2);//NB: the generate function container doens't import anything
+			if(!scope->parent && adjacentScope){
+				distance++;
+				scope = adjacentScope;
+				adjacentScope = nullptr;
+			}
+			else scope = scope->parent;
+		}
+	}
+	visible = copyToRegion(scopes);
+	visibleGeneration = structureGeneration;
+	return visible;
+}
+Scope::Range<Scope* const> Scope::importedScopes(){
+	compiler::SharedStateLock lock;
+	if(importedGeneration == structureGeneration) return imported;
+	std::vector<Scope*> scopes;
+	for(auto scope = this;scope;scope = scope->parent){
+		scope->structureObserved = true;
+		scopes.push_back(scope);
+	}
+	auto result = copyToRegion(scopes);
+	imported.begin = result.begin;
+	imported.end   = result.end;
+	importedGeneration = structureGeneration;
+	return imported;
+}
+
+unittest(visibleScopes){
+	auto module   = new Scope(nullptr);
+	auto imported = new Scope(nullptr);
+	auto block    = new Scope(module);
+	module->import(imported);
+
+	auto scopes = block->visibleScopes();
+	assert(scopes.end - scopes.begin == 3);
+	assert(scopes.begin[0].scope == block && scopes.begin[0].distance == 0);
+	assert(scopes.begin[1].scope == module && scopes.begin[1].distance == 2 && !scopes.begin[1].imported);
+	assert(scopes.begin[2].scope == imported && scopes.begin[2].distance == 3 && scopes.begin[2].imported);
+	assert(block->visibleScopes().begin == scopes.begin);
+
+	//Changing the imports of a scope in the chain rebuilds the array
+	auto other = new Scope(nullptr);
+	module->import(other);
+	assert(block->visibleScopes().end - block->visibleScopes().begin == 4);
+	auto chain = block->importedScopes();
+	assert(chain.end - chain.begin == 2 && chain.begin[1] == module);
+}
+
+#define LOOKUP_IMPORTED(t) \
+	auto scopes = importedScopes(); \
+	for(auto i = scopes.begin;i!=scopes.end;++i){ \
+		auto var = (*i)->t##Definitions.find(name); \
+		if (var && (int)(*var)->isPublic()) return *var; \
+	} \
 	return nullptr
 
 PrefixDefinition* Scope::lookupImportedPrefix(SymbolID name){
-	LOOKUP_IMPORTED(prefix,Prefix);
+	compiler::SharedStateLock lock;
+	LOOKUP_IMPORTED(prefix);
 }
 
 InfixDefinition* Scope::lookupImportedInfix(SymbolID name){
-	LOOKUP_IMPORTED(infix,Infix);
+	compiler::SharedStateLock lock;
+	LOOKUP_IMPORTED(infix);
 }
 
 #define LOOKUP(t,c) \
 	auto var = t##Definitions.find(name); \
-	if (var != t##Definitions.end()) return var->second; \
+	if (var) return *var; \
 	c##Definition* def = nullptr; \
 	for(auto i = imports.begin();i!=imports.end();++i){ \
 		auto d = (*i)->lookupImported##c(name); \
@@ -123,8 +249,9 @@ InfixDefinition* Scope::lookupImportedInfix(SymbolID name){
 
 
 PrefixDefinition* Scope::lookupPrefix(SymbolID name){
+	compiler::SharedStateLock lock;
 	auto var = prefixDefinitions.find(name);
-	if (var != prefixDefinitions.end()) return var->second;
+	if (var) return *var;
 	PrefixDefinition* def = nullptr; 
 	for(auto i = imports.begin();i!=imports.end();++i){ 
 		auto d = (*i)->lookupImportedPrefix(name); 
@@ -143,25 +270,56 @@ PrefixDefinition* Scope::lookupPrefix(SymbolID name){
 }
 
 PrefixDefinition* Scope::lookup(Resolver* resolver,UnresolvedSymbol* node){
+	compiler::SharedStateLock lock;
+	auto name = node->symbol;
+#ifdef DATA_STAT_COLLECT_STATISTICS
+	compiler::statistics.symbolLookups++;
+#endif
+	if(resolvedGeneration == lookupGeneration){
+		if(auto def = resolved.find(name)){
+#ifdef DATA_STAT_COLLECT_STATISTICS
+			compiler::statistics.symbolLookupCacheHits++;
+#endif
+			return *def;
+		}
+	}
+	else {
+		resolved.clear();
+		resolvedGeneration = lookupGeneration;
+	}
+	//A definition which is added while the symbol is looked up invalidates the result
+	auto generation = lookupGeneration;
+	bool cacheable = true;
+	auto def = lookupUncached(resolver,node,cacheable);
+	if(cacheable && lookupGeneration == generation) resolved[name] = def;
+	return def;
+}
+PrefixDefinition* Scope::lookupUncached(Resolver* resolver,UnresolvedSymbol* node,bool& cacheable){
 	Scope* lookup = this;
 	Scope* lookupP2 = nullptr;
 	PrefixDefinition* def = nullptr; 
 	auto name = node->symbol;
 
 	while(true){
+		lookup->observeLookup(this);
 		auto r = lookup->prefixDefinitions.find(name);
-		if (r != lookup->prefixDefinitions.end() && !r->second->isHiddenBeforeDeclaration(resolver->_pass)){
-			return r->second;
+		if(r && (*r)->isFlagSet(PrefixDefinition::LOOKUP_HIDE_BEFORE_DECLARATION)) cacheable = false;
+		if (r && !(*r)->isHiddenBeforeDeclaration(resolver->_pass)){
+			return *r;
 		}
 
 		//Check the imports
 		if(lookup->imports.size()){
 			PrefixDefinition* def = nullptr; 
 			for(auto i = lookup->imports.begin();i!=lookup->imports.end();++i){ 
+				auto scopes = (*i)->importedScopes();
+				for(auto j = scopes.begin;j!=scopes.end;++j) (*j)->observeLookup(this);
 				auto d = (*i)->lookupImportedPrefix(name); 
+				if(d && d->isFlagSet(PrefixDefinition::LOOKUP_HIDE_BEFORE_DECLARATION)) cacheable = false;
 				if(d && !d->isHiddenBeforeDeclaration(resolver->_pass)){
 					if(def && !(def->asOverloadset() && d->asOverloadset()) ){
 						error(node,"Ambiguos import: symbol '%s' is defined in more than one scope.",name);//TODO
+						cacheable = false;
 					}
 					else def = d; 
 				}
@@ -179,90 +337,228 @@ PrefixDefinition* Scope::lookup(Resolver* resolver,UnresolvedSymbol* node){
 	return nullptr;
 }
 
+//Half of the tasks look the symbols up from a block while the other half defines them in the module
+struct ConcurrentLookupTask {
+	Scope* module;
+	Scope* block;
+	ImportedScope* definition;//Unlike a variable, it isn't hidden before its declaration, so its lookups are cached
+	bool define;
+};
+static void concurrentLookupTask(void* argument){
+	auto task = (ConcurrentLookupTask*)argument;
+	if(task->define) task->module->define(task->definition);
+	else {
+		Resolver resolver(nullptr);
+		UnresolvedSymbol symbol(Location(),task->definition->label());
+		task->block->lookup(&resolver,&symbol);
+	}
+}
+
+unittest(concurrentLookups){
+	auto module = new Scope(nullptr);
+	auto block  = new Scope(module);
+	Location location;
+	std::vector<ConcurrentLookupTask> tasks(128);
+	for(size_t i = 0;i<tasks.size();i++){
+		tasks[i].module = module;
+		tasks[i].block  = block;
+		tasks[i].definition = i%2? tasks[i-1].definition : new ImportedScope(SymbolID(format("concurrentLookup%s",i/2).c_str()),location);
+		tasks[i].define = i%2 == 0;
+	}
+	compiler::concurrentResolution = true;
+	{
+		ThreadPool pool(4);
+		for(auto i = tasks.begin();i!=tasks.end();++i) pool.add(&concurrentLookupTask,&(*i));
+		pool.wait();
+	}
+	compiler::concurrentResolution = false;
+
+	//A lookup which raced with the definition mustn't leave a cached miss behind
+	Resolver resolver(nullptr);
+	for(size_t i = 0;i<tasks.size();i+=2){
+		UnresolvedSymbol symbol(location,tasks[i].definition->label());
+		assert(block->lookup(&resolver,&symbol) == tasks[i].definition);
+	}
+}
+
 InfixDefinition* Scope::lookupInfix(SymbolID name){
+	compiler::SharedStateLock lock;
 	LOOKUP(infix,Infix);
 }
 
 
-#define ABS(x) (((x) < 0)   ? -(x) : (x))
+/** Returns the number of single character insertions, deletions and substitutions which turn 's1' into 's2' */
+static int editDistance(const char* s1,size_t len1,const char* s2,size_t len2){
+	enum { InlineLength = 64 };
+	int inlineRows[2][InlineLength + 1];
+	std::vector<int> heapRows;
+	int* prev = inlineRows[0];
+	int* curr = inlineRows[1];
+	if(len2 > InlineLength){
+		heapRows.resize((len2 + 1)*2);
+		prev = &heapRows[0];
+		curr = prev + len2 + 1;
+	}
 
-/** Returns the absolute similarity score for 's1' and 's2' */
-static int similarity(const char* s1, const char* s2)
-{
-	int score = 0;
-	size_t len1 = strlen(s1), len2 = strlen(s2), len = len1 > len2 ?  len1 : len2;
-	size_t i = 0;
+	for(size_t j = 0;j<=len2;j++) prev[j] = int(j);
+	for(size_t i = 1;i<=len1;i++){
+		curr[0] = int(i);
+		for(size_t j = 1;j<=len2;j++){
+			int substitution = prev[j - 1] + (s1[i - 1] == s2[j - 1] ? 0 : 1);
+			int deletion     = prev[j] + 1;
+			int insertion    = curr[j - 1] + 1;
+			curr[j] = std::min(substitution,std::min(deletion,insertion));
+		}
+		std::swap(prev,curr);
+	}
+	return prev[len2];
+}
+static inline int editDistance(SymbolID s1,SymbolID s2){
+	return editDistance(s1.ptr(),s1.length(),s2.ptr(),s2.length());
+}
 
-	while ((len--) > 0) {
-		int abs;
+/**
+	A BK-tree over the names of the prefix definitions in a scope.
+	Every child's edge is labeled with its edit distance to the parent, so by the triangle inequality a search only has to
+	visit the children whose label is close to the distance between the name and the parent.
+*/
+struct SimilarityIndex {
+	struct Entry {
+		SymbolID name;
+		PrefixDefinition* definition;
+		int    distance;//to the parent
+		uint32 firstChild;
+		uint32 nextSibling;
+	};
+	enum { None = 0xFFFFFFFF };
+	std::vector<Entry> entries;
+	size_t version;
 
-		if (len1 >= i && len2 < i) {
-			int x = 0 - s1[i];
-			score += ABS(x);
-		} else if (len2 >= i && len1 < i) {
-			int x = 0 - s2[i];
-			score += ABS(x);
-		} else {
-			abs = ABS(strcmp(s1 + i, s2 + i));
-			score += abs;
-			while (s1[i] == s2[i] && len > 0) {
-				++i;
-				--len;
+	void insert(SymbolID name,PrefixDefinition* definition){
+		Entry entry = { name,definition,0,None,None };
+		if(entries.empty()){
+			entries.push_back(entry);
+			return;
+		}
+		uint32 node = 0;
+		while(true){
+			int distance = editDistance(name,entries[node].name);
+			if(distance == 0) return;
+			auto child = entries[node].firstChild;
+			for(;child != None && entries[child].distance != distance;child = entries[child].nextSibling);
+			if(child == None){
+				entry.distance    = distance;
+				entry.nextSibling = entries[node].firstChild;
+				entries[node].firstChild = uint32(entries.size());
+				entries.push_back(entry);
+				return;
+			}
+			node = child;
+		}
+	}
+	//Returns the closest definition whose distance is less than maxDistance, which is updated to the distance of the found definition.
+	PrefixDefinition* findBest(SymbolID name,int& maxDistance) const {
+		PrefixDefinition* result = nullptr;
+		if(entries.empty()) return result;
+		std::vector<uint32> stack(1,0);
+		while(!stack.empty()){
+			auto node = stack.back();
+			stack.pop_back();
+			int distance = editDistance(name,entries[node].name);
+			if(distance < maxDistance){
+				maxDistance = distance;
+				result = entries[node].definition;
+			}
+			for(auto child = entries[node].firstChild;child != None;child = entries[child].nextSibling){
+				if(std::abs(entries[child].distance - distance) < maxDistance) stack.push_back(child);
 			}
-			++i;
 		}
+		return result;
 	}
-	return score;
+};
+
+unittest(similarityIndex){
+	assert(editDistance("kitten","sitting") == 3);
+	assert(editDistance("foo","foo") == 0);
+	assert(editDistance("",0,"abc",3) == 3);
+
+	SimilarityIndex index;
+	const char* names[] = { "print","println","parse","length","lengthOf","resize","reserve","assert" };
+	for(size_t i = 0;i<sizeof(names)/sizeof(names[0]);i++) index.insert(names[i],(PrefixDefinition*)(names + i));
+	int distance = 3;
+	assert(index.findBest("lenght",distance) == (PrefixDefinition*)(names + 3) && distance == 2);
+	distance = 2;
+	assert(index.findBest("printn",distance) && distance == 1);
+	distance = 2;
+	assert(!index.findBest("xyz",distance) && distance == 2);
 }
 
-#undef ABS
+SimilarityIndex* Scope::similarityIndex(){
+	if(similarity && similarity->version == definitionsVersion) return similarity;
+	if(!similarity) similarity = new SimilarityIndex;
+	similarity->entries.clear();
+	similarity->version = definitionsVersion;
+	for(auto i = prefixDefinitions.begin();i!=prefixDefinitions.end();++i) similarity->insert(i->key,i->value);
+	return similarity;
+}
 
 PrefixDefinition* Scope::lookupBestSimilar(SymbolID name,int threshold){
-	int minWeight = threshold;
+	compiler::SharedStateLock lock;
+	int minDistance = threshold;
 	PrefixDefinition* def = nullptr;
 
-	for(auto i = prefixDefinitions.begin();i!=prefixDefinitions.end();i++){
-		auto weight = similarity((*i).first.ptr(),name.ptr());
-		if(weight < minWeight){
-			minWeight = weight;
-			def= (*i).second;
+	//The module scopes have a lot of definitions, so they are searched using an index
+	if(prefixDefinitions.size() > IndexedDefinitionsThreshold) def = similarityIndex()->findBest(name,minDistance);
+	else {
+		for(auto i = prefixDefinitions.begin();i!=prefixDefinitions.end();++i){
+			auto distance = editDistance(i->key,name);
+			if(distance < minDistance){
+				minDistance = distance;
+				def= i->value;
+			}
 		}
 	}
 
 	if(parent){
-		if(auto p = parent->lookupBestSimilar(name,minWeight)) return p;
+		if(auto p = parent->lookupBestSimilar(name,minDistance)) return p;
 	}
 	if(parent2){
-		if(auto p = parent2->lookupBestSimilar(name,minWeight)) return p;
+		if(auto p = parent2->lookupBestSimilar(name,minDistance)) return p;
 	}
 	return def;
 }
 
 #define CONTAINS(t) \
-	auto var = t.find(name);			    \
-	if (var != t.end()) return var->second; \
-	return nullptr
+	compiler::SharedStateLock lock; \
+	auto var = t.find(name); \
+	return var? *var : nullptr
 
 PrefixDefinition* Scope::containsPrefix(SymbolID name){ CONTAINS(prefixDefinitions); }
 InfixDefinition* Scope::containsInfix(SymbolID name)  { CONTAINS(infixDefinitions);  }
 Overloadset* Scope::containsOverloadset(SymbolID name){
+	compiler::SharedStateLock lock;
 	auto var = prefixDefinitions.find(name);
-	if (var != prefixDefinitions.end()){
-		if(auto os = var->second->asOverloadset()) return os;
+	if (var){
+		if(auto os = (*var)->asOverloadset()) return os;
 	}
 	return nullptr;
 }
 
 void Scope::define(PrefixDefinition* definition){
+	compiler::SharedStateLock lock;
 	auto id = definition->label();
 	auto alreadyDefined = containsPrefix(id);
 	if(alreadyDefined){
 		if(alreadyDefined->asOverloadset()) error(definition,"The name '%s' is already used in the current scope for function '%s'.",id,id);
 		else error(definition,"The name '%s' is already used in the current scope by '%s'.",id,alreadyDefined);
 	}
-	else prefixDefinitions[id] = definition;
+	else {
+		prefixDefinitions[id] = definition;
+		definitionsChanged();
+	}
 }
 void Scope::define(InfixDefinition* definition){
+	compiler::SharedStateLock lock;
 	auto id = definition->label();
 	auto alreadyDefined = containsInfix(id);
 	if(alreadyDefined) error(definition,"'%s' is already (infix)defined in the current scope",id);
@@ -270,16 +566,23 @@ void Scope::define(InfixDefinition* definition){
 }
 
 void Scope::defineFunction(Function* definition){
+	compiler::SharedStateLock lock;
+	overloads::invalidate(definition->label());
 	if(auto alreadyDefined = containsPrefix(definition->label())){
 		if(auto os = alreadyDefined->asOverloadset()) os->push_back(definition);
 		else error(definition,"'%s' is already (prefix)defined in the current scope",definition->label());//TODO better message
 	}
-	else prefixDefinitions[definition->label()] = new Overloadset(definition);
+	else {
+		prefixDefinitions[definition->label()] = new Overloadset(definition);
+		definitionsChanged();
+	}
 }
 
 void Scope::remove(PrefixDefinition* definition){
+	compiler::SharedStateLock lock;
 	auto id = definition->label();
 	assert(containsPrefix(id));
-	prefixDefinitions.erase(id);
+	prefixDefinitions.remove(id);
+	definitionsChanged();
 }
 
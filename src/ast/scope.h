@@ -5,6 +5,7 @@
 #define ARPHA_SCOPE_H
 
 #include "../base/memory.h"
+#include "../base/hashmap.h"
 
 struct Parser;
 struct Node;
@@ -18,12 +19,18 @@ struct DuplicationModifiers;
 struct PrefixDefinition;
 struct InfixDefinition;
 struct UnresolvedSymbol;
+struct SimilarityIndex;
 
 //Scope resolves symbols to corresponding definitions, which tells parser how to parse the encountered symbol
+//The definitions and the lookup caches are guarded by the shared state lock when the function bodies are resolved concurrently.
 struct Scope {
 
 	Scope(Scope* parent);
 
+	//Scopes are allocated in the current memory region and freed together with it.
+	inline void* operator new(size_t size){ return memory::allocate(size); }
+	inline void operator delete(void* p){}
+
 	/**
 	*Imports a scope aliased to string alias
 	*Options:
@@ -43,6 +50,7 @@ struct Scope {
 	PrefixDefinition* lookup(Resolver* resolver,UnresolvedSymbol* node);
 
 	//not found
+	//Returns the definition with the smallest edit distance to the given name, which has to be less than the threshold.
 	PrefixDefinition* lookupBestSimilar(SymbolID name,int threshold);
 
 	Overloadset* containsOverloadset(SymbolID name);
@@ -55,9 +63,31 @@ struct Scope {
 	void defineFunction(Function* definition);
 
 	void setParent(Scope* scope);
+	//Unlike setParent, doesn't inherit the function owner of the new parent
+	void changeParent(Scope* scope);
+	void setParent2(Scope* scope);
 
 	Scope* moduleScope();
 
+	/**
+		The scopes which are searched for the overloads of a function, in the order of the search.
+		They are the scope itself, its imports, and then the scopes visible from its parent and parent2.
+		The distance of a scope increases with each step away from this scope.
+	*/
+	struct VisibleScope {
+		Scope* scope;
+		int    distance;
+		bool   imported;//Only the public definitions from the imported scopes are visible
+	};
+	template<typename T>
+	struct Range {
+		T* begin;
+		T* end;
+	};
+	Range<const VisibleScope> visibleScopes();
+	//The scopes whose public definitions are visible to the scopes which import this scope - this scope and its parents.
+	Range<Scope* const> importedScopes();
+
 	Scope* parent;
 
 	//Required for generated functions polymorphism :(
@@ -69,8 +99,9 @@ struct Scope {
 
 	size_t numberOfDefinitions() const;
 
-	std::map<SymbolID,PrefixDefinition*> prefixDefinitions;
-	std::map<SymbolID,InfixDefinition*> infixDefinitions;
+	//Most of the scopes have just a few definitions, which are stored inline
+	SmallHashMap<SymbolID,PrefixDefinition*> prefixDefinitions;
+	SmallHashMap<SymbolID,InfixDefinition*> infixDefinitions;
 	std::vector<Scope*> imports;
 
 	//definition modifier commands(visibility mode, etc)
@@ -82,6 +113,40 @@ private:
 	std::vector<std::pair<Scope*,std::pair<SymbolID,bool> > > exportedImports;
 	std::vector<ImportedScope*> broadcastedImports;
 
+	/**
+		The visible and imported scopes are flattened into arrays when they are needed.
+		The arrays are rebuilt when the imports or the parents of any scope which was used to build them change.
+		The old arrays stay in the region, so a range which is being iterated isn't invalidated.
+	*/
+	Range<const VisibleScope> visible;
+	Range<Scope* const> imported;
+	size_t visibleGeneration;
+	size_t importedGeneration;
+	bool   structureObserved;
+	static size_t structureGeneration;
+	void   structureChanged();
+
+	/**
+		The results of the symbol lookups done by the resolver from this scope.
+		A null value means that the symbol wasn't found. Each scope has its own generation, which is bumped when a definition
+		or an import is added to or removed from it, and in the scopes whose cached lookups searched it(the observers),
+		so a change invalidates only the caches which depend on the changed scope. The lookups which came across a definition
+		that is hidden before its declaration or which reported an ambiguity aren't cached.
+	*/
+	HashMap<SymbolID,PrefixDefinition*> resolved;
+	size_t resolvedGeneration;
+	size_t lookupGeneration;
+	SmallHashMap<Scope*,bool> lookupObservers;
+	void   observeLookup(Scope* scope);
+	void   definitionsChanged();
+	PrefixDefinition* lookupUncached(Resolver* resolver,UnresolvedSymbol* node,bool& cacheable);
+
+	//The index for lookupBestSimilar, which is built for the scopes with many definitions when it's needed.
+	enum { IndexedDefinitionsThreshold = 32 };
+	size_t definitionsVersion;
+	SimilarityIndex* similarity;
+	SimilarityIndex* similarityIndex();
+
 };
 
 
@@ -47,7 +47,7 @@ void BoolExpression::dumpImplementation(Dumper& dumper) const {
 }
 void StringLiteral::dumpImplementation(Dumper& dumper) const {
 	dumper.print("\"");
-	dumper.print(block.ptr());
+	dumper.print(std::string(block.ptr(),block.length()).c_str());
 	dumper.print("\"");
 	if(isFlagSet(LiteralNode::EXPLICIT_TYPE)){
 		dumper.print(" as ");
@@ -2,6 +2,7 @@
 #include "../base/bigint.h"
 #include "../base/symbol.h"
 #include "../base/system.h"
+#include "../base/hashmap.h"
 #include "../compiler.h"
 #include "node.h"
 #include "declarations.h"
@@ -12,34 +13,50 @@
 
 /**
   This range iterates over all the possible meanings of a given type( direct, subtyping, implicit conversions etc)
+  The meanings are enumerated lazily, so a search which stops at the first meaning doesn't look at the others.
+  The extended records are visited depth first using a stack of frames, which is stored inline unless the
+  hierarchy is deeper than InlineDepth.
 */
 struct TypeMeaningsRange {
 private:
-
-	void getRecordSubtypes(Record* record,uint32 filters);
-
-	void gatherMeanings(Type* type,uint32 filters);
-
-	struct Match {
-		Type* type;
-		int   weight;
+	enum {
+		InlineDepth = 4
+	};
+	enum {
+		RECORD_FIELDS,STATIC_ARRAY,POINTER,DONE
 	};
-	std::vector<Match> meanings;
-	std::vector<Match>::iterator currMeaning;
+	struct Frame {
+		Type*   type;
+		Record* record;//The record whose extending fields are visited, can be null
+		uint32  field;
+		uint32  stage;
+	};
+	Frame  inlineFrames[InlineDepth];
+	Frame* frames;
+	size_t depth;
+	size_t capacity;
+
+	Type* currType;
+	int   currWeight;
 
-	inline void add(Type* type,int weight){ Match m = { type,weight };meanings.push_back(m); }
+	void push(Type* type);
+	bool next();
 public:
 
 	TypeMeaningsRange(Type* type,uint32 filters = 0);
+	~TypeMeaningsRange();
 
-	inline bool isEmpty()       { return currMeaning == meanings.end(); }
-	inline void advance()       { ++currMeaning; }
-	inline Type* currentType()  { return currMeaning->type; }
-	inline int   currentWeight(){ return currMeaning->weight; }
+	inline bool isEmpty()       { return depth == 0; }
+	inline void advance()       { next(); }
+	inline Type* currentType()  { return currType; }
+	inline int   currentWeight(){ return currWeight; }
 };
-TypeMeaningsRange::TypeMeaningsRange(Type* type,uint32 filters){
-	gatherMeanings(type,filters);
-	currMeaning = meanings.begin();
+TypeMeaningsRange::TypeMeaningsRange(Type* type,uint32 filters) : frames(inlineFrames),depth(0),capacity(InlineDepth) {
+	push(type);
+	next();
+}
+TypeMeaningsRange::~TypeMeaningsRange(){
+	if(frames != inlineFrames) System::free(frames);
 }
 
 Type* TypePatternUnresolvedExpression::type() const {
@@ -371,8 +388,83 @@ data::ast::Search::Result functionMatchesTraitsMethod(Type* type,Trait* trait,Fu
 	return data::ast::Search::NotFound;
 }
 
+/**
+* The trait satisfaction cache.
+* Whether a type satisfies a trait depends on the overloads of the trait's methods which are visible from the expansion scope.
+* A result is reused while the visible scopes stay the same and no new overload with the name of one of the methods is defined.
+* The results which depend on unresolved functions aren't cached.
+*/
+namespace {
+	struct TraitCheck {
+		Type*  type;
+		Trait* trait;
+		Scope* scope;
+
+		inline bool operator ==(const TraitCheck& other) const {
+			return type == other.type && trait == other.trait && scope == other.scope;
+		}
+	};
+	struct TraitCheckHasher {
+		static inline size_t hash(const TraitCheck& key){
+			auto h = hashing::combine(hashing::Hasher<Type*>::hash(key.type),hashing::Hasher<Trait*>::hash(key.trait));
+			return hashing::combine(h,hashing::Hasher<Scope*>::hash(key.scope));
+		}
+	};
+	struct TraitCheckResult {
+		data::ast::Search::Result result;
+		const Scope::VisibleScope* visibleScopes;
+		size_t generation;
+		std::vector<Node*> traitExpansions;
+	};
+	HashMap<TraitCheck,TraitCheckResult,TraitCheckHasher> traitChecks;
+
+	size_t methodsGeneration(Trait* trait){
+		size_t result = 0;
+		for(auto i = trait->methods.begin();i!=trait->methods.end();i++) result += ::overloads::generation((*i)->label());
+		return result;
+	}
+}
+
+data::ast::Search::Result typeSatisfiesTraitUncached(Scope* scope,Type* type,Trait* trait,Resolver* resolver,std::vector<Node*>* traitExpansions);
+
 //returns Found if the type satisfies trait
 data::ast::Search::Result typeSatisfiesTrait(Scope* scope,Type* type,Trait* trait,Resolver* resolver,std::vector<Node*>* traitExpansions){
+	TraitCheck key = { type,trait,scope };
+	const Scope::VisibleScope* visibleScopes;
+	size_t generation;
+	{
+		//Only the cache is accessed under the lock, the check itself runs concurrently
+		compiler::SharedStateLock lock;
+#ifdef DATA_STAT_COLLECT_STATISTICS
+		compiler::statistics.traitChecks++;
+#endif
+		visibleScopes = scope->visibleScopes().begin;
+		generation    = methodsGeneration(trait);
+		if(auto cached = traitChecks.find(key)){
+			if(cached->visibleScopes == visibleScopes && cached->generation == generation){
+#ifdef DATA_STAT_COLLECT_STATISTICS
+				compiler::statistics.traitCheckCacheHits++;
+#endif
+				if(cached->result == data::ast::Search::Found) *traitExpansions = cached->traitExpansions;
+				return cached->result;
+			}
+		}
+	}
+	auto result = typeSatisfiesTraitUncached(scope,type,trait,resolver,traitExpansions);
+	if(result != data::ast::Search::NotAllElementsResolved){
+		compiler::SharedStateLock lock;
+		//The overloads which were defined during the check make the next lookup check again
+		auto& cached = traitChecks[key];
+		cached.result        = result;
+		cached.visibleScopes = visibleScopes;
+		cached.generation    = generation;
+		if(result == data::ast::Search::Found) cached.traitExpansions = *traitExpansions;
+		else cached.traitExpansions.clear();
+	}
+	return result;
+}
+
+data::ast::Search::Result typeSatisfiesTraitUncached(Scope* scope,Type* type,Trait* trait,Resolver* resolver,std::vector<Node*>* traitExpansions){
 	if(!trait->isImplicit()){
 		if(auto record = type->asRecord()){
 			if(!record->declaration->extendsConcept(trait)) return data::ast::Search::NotFound;
@@ -559,43 +651,140 @@ Type::Type(int kind,int subtype) : type(kind),flags(0) {
 	nodeSubtype = subtype;
 }
 
+/**
+* Type interning
+* The builtin and the derived types are unique, so that isSame can compare them by pointer.
+*/
+namespace {
+	struct TypeKey {
+		int    kind;
+		int    bits;//bits, qualifier flags or calling convention
+		Type*  argument;
+		Type*  returns;
+		size_t size;
+
+		inline TypeKey(int kind,int bits,Type* argument = nullptr,Type* returns = nullptr,size_t size = 0) : 
+			kind(kind),bits(bits),argument(argument),returns(returns),size(size) {}
+		inline TypeKey() {}
+
+		inline bool operator ==(const TypeKey& other) const {
+			return kind == other.kind && bits == other.bits && argument == other.argument && returns == other.returns && size == other.size;
+		}
+	};
+	struct TypeKeyHasher {
+		static inline size_t hash(const TypeKey& key){
+			auto h = hashing::combine(size_t(key.kind),size_t(key.bits));
+			h = hashing::combine(h,hashing::Hasher<Type*>::hash(key.argument));
+			h = hashing::combine(h,hashing::Hasher<Type*>::hash(key.returns));
+			return hashing::combine(h,key.size);
+		}
+	};
+	HashMap<TypeKey,Type*,TypeKeyHasher>& internedTypes(){
+		static HashMap<TypeKey,Type*,TypeKeyHasher> types;
+		return types;
+	}
+
+	inline Type* findInterned(const TypeKey& key){
+		auto type = internedTypes().find(key);
+		if(!type) return nullptr;
+#ifdef DATA_STAT_COLLECT_STATISTICS
+		compiler::statistics.typesReused++;
+#endif
+		return *type;
+	}
+	template<typename T>
+	inline T* intern(const TypeKey& key,T* type){
+		internedTypes().insert(key,type);
+		return type;
+	}
+	//Interned types are shared between modules, so they are allocated in the global region.
+	//The lookup and the insertion are done under the shared state lock, so concurrently resolved bodies get the same type.
+	struct InternedTypeAllocation {
+		memory::Region* prev;
+		inline InternedTypeAllocation()  { prev = memory::setCurrentRegion(nullptr); }
+		inline ~InternedTypeAllocation() { memory::setCurrentRegion(prev); }
+	};
+}
+
 Type* Type::getIntegerType(int bits,bool isSigned){
-	return new Type(INTEGER,isSigned? -bits:bits);
+	compiler::SharedStateLock lock;
+	TypeKey key(INTEGER,isSigned? -bits:bits);
+	if(auto t = findInterned(key)) return t;
+	InternedTypeAllocation _;
+	return intern(key,new Type(INTEGER,isSigned? -bits:bits));
 }
 Type* Type::getFloatType(int bits){
-	return new Type(FLOAT,bits);
+	compiler::SharedStateLock lock;
+	TypeKey key(FLOAT,bits);
+	if(auto t = findInterned(key)) return t;
+	InternedTypeAllocation _;
+	return intern(key,new Type(FLOAT,bits));
 }
 Type* Type::getCharType(int bits){
-	return new Type(CHAR,bits);
+	compiler::SharedStateLock lock;
+	TypeKey key(CHAR,bits);
+	if(auto t = findInterned(key)) return t;
+	InternedTypeAllocation _;
+	return intern(key,new Type(CHAR,bits));
 }
 Type* Type::getNaturalType(){
+	compiler::SharedStateLock lock;
+	TypeKey key(NATURAL,0);
+	if(auto t = findInterned(key)) return t;
+	InternedTypeAllocation _;
 	auto t = new Type(NATURAL);
 	t->bits = 32;//TODO
-	return t;
+	return intern(key,t);
 }
 Type* Type::getUintptrType(){
+	compiler::SharedStateLock lock;
+	TypeKey key(UINTPTRT,0);
+	if(auto t = findInterned(key)) return t;
+	InternedTypeAllocation _;
 	auto t = new Type(UINTPTRT);
 	t->bits = 32;//TODO
-	return t;
+	return intern(key,t);
 }
 Type* Type::getLinearSequence(Type* next){
-	return new Type(LINEAR_SEQUENCE,next);
+	compiler::SharedStateLock lock;
+	TypeKey key(LINEAR_SEQUENCE,0,next);
+	if(auto t = findInterned(key)) return t;
+	InternedTypeAllocation _;
+	return intern(key,new Type(LINEAR_SEQUENCE,next));
 }
 Type* Type::getPointerType(Type* next){
-	return new Type(Type::POINTER,next);
+	compiler::SharedStateLock lock;
+	TypeKey key(POINTER,0,next);
+	if(auto t = findInterned(key)) return t;
+	InternedTypeAllocation _;
+	return intern(key,new Type(Type::POINTER,next));
 }
 Type* Type::getReferenceType(Type* next){
-	return new Type(Type::REFERENCE,next);
+	compiler::SharedStateLock lock;
+	TypeKey key(REFERENCE,0,next);
+	if(auto t = findInterned(key)) return t;
+	InternedTypeAllocation _;
+	return intern(key,new Type(Type::REFERENCE,next));
+}
+//NB: the qualifier types are shared, so adding a qualifier returns a new type instead of modifying the given one
+static Type* getQualifier(Type* next,uint16 flags){
+	if(next->isQualifier()){
+		flags |= next->flags;
+		next = next->next();
+	}
+	compiler::SharedStateLock lock;
+	TypeKey key(Type::QUALIFIER,flags,next);
+	if(auto t = findInterned(key)) return t;
+	InternedTypeAllocation _;
+	auto t = new Type(Type::QUALIFIER,next);
+	t->setFlag(flags);
+	return intern(key,t);
 }
 Type* Type::getConstQualifier(Type* next){
-	if(!next->isQualifier()) next = new Type(Type::QUALIFIER,next);
-	next->setFlag(CONST_QUALIFIER);
-	return next;
+	return getQualifier(next,CONST_QUALIFIER);
 }
 Type* Type::getLocalQualifier(Type* next){
-	if(!next->isQualifier()) next = new Type(Type::QUALIFIER,next);
-	next->setFlag(LOCAL_QUALIFIER);
-	return next;
+	return getQualifier(next,LOCAL_QUALIFIER);
 }
 
 void Type::setFlag(uint16 flag){
@@ -646,6 +835,7 @@ bool Type::isPartiallyResolved() const {
 }
 
 bool Type::isSame(Type* other){
+	if(this == other) return true;
 	if(this->type != other->type) return false;
 	switch(type){
 		case VOID: case TYPE: case BOOL: return true;
@@ -819,13 +1009,34 @@ bool Type::integerFits(uint64 value,bool isNegative){
 #undef RANGE
 }
 
+//Checks the integer against the range of this integer type
+bool Type::integerFits(const BigInt& value){
+	for(int i = 1;i<value.wordCount;i++){
+		if(value.word(i)) return false;
+	}
+	uint64 magnitude = value.word(0);
+	bool isSigned = isInteger() && bits < 0;
+	int  width    = isInteger()? (isSigned? -bits : bits) : 64;//natural and uintptr are checked against the widest platform
+	if(!isSigned) return !value.isNegative() && (width >= 64 || magnitude < (uint64(1) << width));
+	uint64 limit = uint64(1) << (width - 1);
+	return value.isNegative()? magnitude <= limit : magnitude < limit;
+}
+unittest(integerFits){
+	Type byte(Type::INTEGER,-8),word(Type::INTEGER,64);
+	assert(byte.integerFits(BigInt(int64(-128))) && !byte.integerFits(BigInt(int64(128))));
+	BigInt big(std::numeric_limits<uint64>::max());
+	assert(word.integerFits(big) && !byte.integerFits(big));
+	big += BigInt(uint64(1));
+	assert(!word.integerFits(big));
+}
+
 bool   Type::doesLiteralFit(IntegerLiteral* node){
 	if(isInteger() ||  isPlatformInteger() || isUintptr()){
-		return integerFits(node->integer.u64,node->integer.isNegative());
+		return integerFits(node->integer);
 	}
 	else {
 		assert(isChar());
-		if(node->integer.isNegative()) return false;
+		if(!node->integer.isWord() || node->integer.isNegative()) return false;
 		return characterFits(bits,node->integer.u64);
 	}
 }
@@ -1051,15 +1262,6 @@ int recordSubtyping(Type* givenType,Node** node,Type* nodeType,bool doTransform)
 	}*/
 	return -1;
 }
-void TypeMeaningsRange::getRecordSubtypes(Record* record,uint32 filters){
-	for(auto field = record->fields.begin(); field != record->fields.end();++field){
-		if((*field).isExtending){
-			add((*field).type.type(),RECORD_SUBTYPE);
-			gatherMeanings((*field).type.type(),filters);
-		}
-	}
-}
-
 int referenceOf(Type* givenType, Node** node, Type* nodeType,bool doTransform,uint32 filters){
 	if((*node)->isConst()) return -1;//no &1 !
 	//auto ptrType = givenType->next()//givenType->isReference()? Type::getReferenceType(nodeType) : Type::getPointerType(nodeType);
@@ -1147,23 +1349,60 @@ int Type::assignFrom(Node** expression,Type* type,bool doTransform,uint32 filter
 
 	return -1;
 }
-void TypeMeaningsRange::gatherMeanings(Type* type,uint32 filters){
-
+void TypeMeaningsRange::push(Type* type){
+	if(depth == capacity){
+		auto grown = (Frame*)System::malloc(sizeof(Frame)*capacity*2);
+		memcpy(grown,frames,sizeof(Frame)*depth);
+		if(frames != inlineFrames) System::free(frames);
+		frames = grown;
+		capacity *= 2;
+	}
 	Record* record = type->asRecord();
-	if(!record){
-		if(type->isPointer()){
-			record = type->next()->asRecord();
-			if(record) getRecordSubtypes(record,filters);
+	if(!record && type->isPointer()) record = type->next()->asRecord();
+	Frame frame = { type,record,0,RECORD_FIELDS };
+	frames[depth++] = frame;
+}
+//The meanings of a type are the extended records followed by their meanings, the linear sequence of a static array and the pointer type
+bool TypeMeaningsRange::next(){
+	while(depth){
+		auto frame = frames + depth - 1;
+		switch(frame->stage){
+		case RECORD_FIELDS:
+			if(frame->record && frame->field < frame->record->fields.size()){
+				auto& field = frame->record->fields[frame->field++];
+				if(field.isExtending){
+					currType   = field.type.type();
+					currWeight = RECORD_SUBTYPE;
+					push(currType);
+					return true;
+				}
+				continue;
+			}
+			frame->stage = STATIC_ARRAY;
+			//fallthrough
+		case STATIC_ARRAY:
+			frame->stage = POINTER;
+			if(frame->type->isStaticArray()){
+				currType   = Type::getLinearSequence(frame->type->next());
+				currWeight = CONVERSION_SAME_KIND;
+				return true;
+			}
+			//fallthrough
+		case POINTER:
+			frame->stage = DONE;
+			if(!frame->type->isPointer()){
+				currType   = Type::getPointerType(frame->type);
+				currWeight = ADDRESSOF;
+				return true;
+			}
+			//fallthrough
+		default:
+			depth--;
 		}
 	}
-	else getRecordSubtypes(record,filters);
-
-	if(type->isStaticArray()) add(Type::getLinearSequence(type->next()),CONVERSION_SAME_KIND);
-	if(!type->isPointer()) add(Type::getPointerType(type),ADDRESSOF);
+	return false;
 }
 
-
-
 int   Type::canAssignFrom(Node* expression,Type* type,uint32 filters){
 	return assignFrom(&expression,type,false,filters);
 }
@@ -1342,11 +1581,15 @@ bool Type::canBeContainedInOther(){
 * Function pointer type
 */
 FunctionPointer* FunctionPointer::get(Type* argument,Type* ret,data::ast::Function::CallConvention cc){
+	compiler::SharedStateLock lock;
+	TypeKey key(FUNCTION_POINTER,int(cc),argument,ret);
+	if(auto t = findInterned(key)) return static_cast<FunctionPointer*>(t);
+	InternedTypeAllocation _;
 	auto type = new FunctionPointer();
 	type->argument = argument;
 	type->_returns = ret;
 	type->cc = cc;
-	return type;
+	return intern(key,type);
 }
 FunctionPointer* Type::asFunctionPointer(){
 	return type == FUNCTION_POINTER? static_cast<FunctionPointer*>(this) : nullptr;
@@ -1358,10 +1601,14 @@ FunctionPointer* Type::asFunctionPointer(){
 */
 StaticArray* StaticArray::get(Type* next,size_t N){
 	assert(N);
+	compiler::SharedStateLock lock;
+	TypeKey key(STATIC_ARRAY,0,next,nullptr,N);
+	if(auto t = findInterned(key)) return static_cast<StaticArray*>(t);
+	InternedTypeAllocation _;
 	auto t = new StaticArray();
 	t->argument = next;
 	t->size = N;
-	return t;
+	return intern(key,t);
 }
 StaticArray* Type::asStaticArray(){
 	return type == STATIC_ARRAY? static_cast<StaticArray*>(this) : nullptr;
@@ -1371,8 +1618,86 @@ StaticArray* Type::asStaticArray(){
 /**
 * Anonymous records/variants
 */
-std::vector<std::pair<Type**,size_t>>    anonymousRecordTypes ;
-std::vector<std::pair<SymbolID*,size_t>> anonymousRecordFields;
+//A hash which is consistent with Type::isSame
+size_t Type::structuralHash(){
+	size_t h = size_t(type);
+	switch(type){
+	case RECORD: case VARIANT: case TRAIT:
+		return hashing::combine(h,hashing::Hasher<Type*>::hash(this));
+	case INTEGER: case FLOAT: case CHAR:
+		return hashing::combine(h,size_t(bits));
+	case POINTER: case REFERENCE: case LINEAR_SEQUENCE:
+		return hashing::combine(h,argument->structuralHash());
+	case STATIC_ARRAY:
+		return hashing::combine(hashing::combine(h,argument->structuralHash()),asStaticArray()->length());
+	case FUNCTION_POINTER:
+		return hashing::combine(hashing::combine(h,argument->structuralHash()),asFunctionPointer()->returns()->structuralHash());
+	case NODE:
+		return hashing::combine(h,size_t(nodeSubtype));
+	case ANONYMOUS_RECORD: case ANONYMOUS_VARIANT:
+		return hashing::combine(h,hashing::Hasher<Type**>::hash(static_cast<AnonymousAggregate*>(this)->types));
+	case VARIANT_OPTION:
+		return hashing::combine(h,size_t(optionID));
+	case QUALIFIER:
+		return hashing::combine(hashing::combine(h,size_t(flags)),argument->structuralHash());
+	default:
+		return h;
+	}
+}
+
+namespace {
+	/**
+	* A key for the unique arrays of anonymous record field types/names.
+	* The key can point to an array of fields, in which case the stride is the size of the field.
+	*/
+	template<typename T>
+	struct AggregateArrayKey {
+		const T* elements;
+		size_t   stride;
+		size_t   count;
+		size_t   hash;
+
+		inline const T& operator[](size_t i) const {
+			return *reinterpret_cast<const T*>(reinterpret_cast<const char*>(elements) + i*stride);
+		}
+	};
+
+	typedef AggregateArrayKey<Type*> TypeArrayKey;
+	inline bool operator ==(const TypeArrayKey& a,const TypeArrayKey& b){
+		if(a.hash != b.hash || a.count != b.count) return false;
+		for(size_t i = 0;i<a.count;i++){
+			if(!a[i]->isSame(b[i])) return false;
+		}
+		return true;
+	}
+	typedef AggregateArrayKey<SymbolID> FieldArrayKey;
+	inline bool operator ==(const FieldArrayKey& a,const FieldArrayKey& b){
+		if(a.hash != b.hash || a.count != b.count) return false;
+		for(size_t i = 0;i<a.count;i++){
+			if(a[i] != b[i]) return false;
+		}
+		return true;
+	}
+	struct AggregateArrayKeyHasher {
+		template<typename T>
+		static inline size_t hash(const AggregateArrayKey<T>& key){ return key.hash; }
+	};
+
+	TypeArrayKey typeArrayKey(const AnonymousAggregate::Field* fields,size_t count){
+		TypeArrayKey key = { &fields[0].type,sizeof(AnonymousAggregate::Field),count,count };
+		for(size_t i = 0;i<count;i++) key.hash = hashing::combine(key.hash,key[i]->structuralHash());
+		return key;
+	}
+	FieldArrayKey fieldArrayKey(const AnonymousAggregate::Field* fields,size_t count){
+		FieldArrayKey key = { &fields[0].name,sizeof(AnonymousAggregate::Field),count,count };
+		for(size_t i = 0;i<count;i++) key.hash = hashing::combine(key.hash,key[i].hash());
+		return key;
+	}
+
+	//The unique arrays of field types and names for anonymous records
+	HashMap<TypeArrayKey,Type**,AggregateArrayKeyHasher>      anonymousRecordTypes;
+	HashMap<FieldArrayKey,SymbolID*,AggregateArrayKeyHasher>  anonymousRecordFields;
+}
 
 AnonymousAggregate::AnonymousAggregate(Type** t,SymbolID* fs,size_t n,bool isVariant): Type(isVariant? ANONYMOUS_VARIANT: ANONYMOUS_RECORD),types(t),fields(fs),numberOfFields(n) {
 	assert(n > 1);
@@ -1414,60 +1739,50 @@ AnonymousAggregate* AnonymousAggregate::create(Field* fields,size_t fieldsCount,
 		if(!(*i).name.isNull()) areFieldsUnnamed = false;
 	}
 
+	//The arrays are shared by the concurrently resolved bodies
+	compiler::SharedStateLock lock;
+
 	//find the corresponding type array
-	Type** typeArray = nullptr;
-	for(auto i = anonymousRecordTypes.begin();i!=anonymousRecordTypes.end();i++){
-		if((*i).second == fieldsCount){
-			auto otherFields = (*i).first;
-			bool allTypesSame = true;
-			for(size_t j=0;j<fieldsCount;j++){
-				if(!(otherFields[j]->isSame(fields[j].type))){
-					allTypesSame = false;
-					break;
-				}
-			}
-			if(allTypesSame){
-				typeArray = otherFields;
-				break;
-			}
-		}
-	}
-	if(!typeArray){
+	Type** typeArray;
+	auto typeKey = typeArrayKey(fields,fieldsCount);
+	if(auto existing = anonymousRecordTypes.find(typeKey)) typeArray = *existing;
+	else {
 		typeArray = (Type**)System::malloc(sizeof(Type*)*fieldsCount);
 		for(size_t j=0;j<fieldsCount;j++) typeArray[j] = fields[j].type;
-		anonymousRecordTypes.push_back(std::make_pair(typeArray,fieldsCount));
+		typeKey.elements = typeArray;
+		typeKey.stride   = sizeof(Type*);
+		anonymousRecordTypes.insert(typeKey,typeArray);
 	}
 
 	if(areFieldsUnnamed) return new AnonymousAggregate(typeArray,nullptr,fieldsCount,isVariant);
 
 	//find the corresponding field array
-	SymbolID* symbolArray = nullptr;
-	for(auto i = anonymousRecordFields.begin();i!=anonymousRecordFields.end();i++){
-		if((*i).second == fieldsCount){
-			auto otherFields = (*i).first;
-			bool allSymbolsSame = true;
-			for(size_t j=0;j<fieldsCount;j++){
-				if(!(otherFields[j] == fields[j].name)){
-					allSymbolsSame = false;
-					break;
-				}
-			}
-			if(allSymbolsSame){
-				symbolArray = otherFields;
-				break;
-			}
-		}
-	}
-	if(!symbolArray){
+	SymbolID* symbolArray;
+	auto fieldKey = fieldArrayKey(fields,fieldsCount);
+	if(auto existing = anonymousRecordFields.find(fieldKey)) symbolArray = *existing;
+	else {
 		symbolArray = (SymbolID*)System::malloc(sizeof(SymbolID)*fieldsCount);
 		for(size_t j=0;j<fieldsCount;j++) symbolArray[j] = fields[j].name;
-		anonymousRecordFields.push_back(std::make_pair(symbolArray,fieldsCount));
+		fieldKey.elements = symbolArray;
+		fieldKey.stride   = sizeof(SymbolID);
+		anonymousRecordFields.insert(fieldKey,symbolArray);
 	}
 	return new AnonymousAggregate(typeArray,symbolArray,fieldsCount,isVariant);
 }
 AnonymousAggregate* AnonymousAggregate::create(AnonymousAggregate* other,bool isVariant){
 	return new AnonymousAggregate(other->types,other->fields,other->numberOfFields,isVariant);
 }
+
+unittest(anonymousRecordHash){
+	//The records with the same field types are distinct objects, so they have to be compared and hashed structurally
+	AnonymousAggregate::Field fields[] = { { SymbolID(),new Type(Type::NODE,-1) },{ SymbolID(),new Type(Type::NODE,-1) } };
+	AnonymousAggregate::Field sameFields[] = { { SymbolID(),new Type(Type::NODE,-1) },{ SymbolID(),new Type(Type::NODE,-1) } };
+	auto record = AnonymousAggregate::create(fields,2);
+	auto same   = AnonymousAggregate::create(sameFields,2);
+	assert(record != same);
+	assert(record->isSame(same));
+	assert(record->structuralHash() == same->structuralHash());
+}
 AnonymousAggregate* AnonymousAggregate::getVector(Type* type,size_t elementsCount){
 	std::vector<Field> fields;
 	Field field = { SymbolID(),type };
@@ -118,9 +118,14 @@ struct Type {
 	Type(int kind,Type* next);//ptr | bounded pointer
 	Type(int kind,int subtype);//node
 
+	//Types are allocated in the current memory region and freed together with it.
+	inline void* operator new(size_t size){ return memory::allocate(size); }
+	inline void operator delete(void* p){}
+
 	static Type* getIntegerType(int bits,bool isSigned);
 	static Type* getBestFitIntegerType(const BigInt& value);
 	bool   integerFits(uint64 value,bool isNegative);
+	bool   integerFits(const BigInt& value);
 	bool   doesLiteralFit(IntegerLiteral* node); // type must be integer or character
 
 	static Type* getFloatType(int bits);
@@ -201,6 +206,7 @@ struct Type {
 
 
 	bool isSame(Type* other);
+	size_t structuralHash(); //Consistent with isSame
 
 	void setFlag(uint16 flag);
 	bool isFlagSet(uint16 flag) const;
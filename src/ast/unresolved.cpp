@@ -37,7 +37,8 @@ bool isTypeError(TypePatternUnresolvedExpression& type){
 
 void Resolver::reportUnresolved(UnresolvedSymbol* unr){
 	auto scope = (unr->explicitLookupScope ? unr->explicitLookupScope : currentScope());
-	auto correction = scope->lookupBestSimilar(unr->symbol,20);
+	//Allow one typo for every three characters, up to two typos
+	auto correction = scope->lookupBestSimilar(unr->symbol,int(std::min(unr->symbol.length()/3,size_t(2))) + 1);
 	if(correction){
 		ERROR(unr,"The symbol '%s' is undefined. Perphaps you mean '%s'?",unr->symbol,correction->label());
 	} else {
@@ -37,6 +37,13 @@ inline T* _ensure(int line,const char* file,T* x){
 }
 #define ensure(x) _ensure(__LINE__,__FILE__,x)
 
+//Thread local storage for POD types
+#ifdef _MSC_VER
+	#define THREAD_LOCAL __declspec(thread)
+#else
+	#define THREAD_LOCAL __thread
+#endif
+
 //class non copyable
 #define NOCOPY(t) \
 	t(const t &); \
@@ -1,5 +1,8 @@
+#include <algorithm>
+#include <limits>
 #include "base.h"
 #include "bigint.h"
+#include "system.h"
 
 BigInt::BigInt() : wordCount(1),negative(false),u64(0) {}
 BigInt::BigInt(uint64 v) : wordCount(1) {
@@ -8,17 +11,39 @@ BigInt::BigInt(uint64 v) : wordCount(1) {
 BigInt::BigInt(int64 v) : wordCount(1) {
 	*this = v;
 }
+BigInt::BigInt(const BigInt& other) : wordCount(1) {
+	*this = other;
+}
+void BigInt::freeWords(){
+	System::free(words);
+	wordCount = 1;
+	u64 = 0;
+}
+BigInt& BigInt::operator =(const BigInt& other){
+	if(this == &other) return *this;
+	if(wordCount > 1) freeWords();
+	negative = other.negative;
+	if(other.wordCount == 1) u64 = other.u64;
+	else {
+		words = (uint64*)System::malloc(sizeof(uint64)*other.wordCount);
+		memcpy(words,other.words,sizeof(uint64)*other.wordCount);
+	}
+	wordCount = other.wordCount;
+	return *this;
+}
 BigInt& BigInt::operator =(const uint64 v){
+	if(wordCount > 1) freeWords();
 	negative = false;
 	wordCount = 1;
 	u64 = v;
 	return *this;
 }
 BigInt& BigInt::operator =(const int64 v){
+	if(wordCount > 1) freeWords();
 	wordCount = 1;
 	if(v<0){
 		negative = true;
-		u64 = (uint64)(-v);
+		u64 = 0ULL - (uint64)v;
 	}else{
 		negative = false;
 		u64 = (uint64)(v);
@@ -29,23 +54,242 @@ BigInt& BigInt::operator =(const int v){
 	*this = (int64)v;
 	return *this;
 }
+
+/**
+* The magnitude of a big integer split into 32 bit limbs.
+* It is used for the multi word arithmetic.
+*/
+struct BigIntMagnitude {
+	std::vector<uint32> limbs;//least significant limb first, no leading zero limbs
+
+	BigIntMagnitude(){}
+	explicit BigIntMagnitude(const BigInt& value){
+		limbs.resize(size_t(value.wordCount)*2);
+		for(int i = 0;i < value.wordCount;i++){
+			auto w = value.word(i);
+			limbs[i*2]   = uint32(w);
+			limbs[i*2+1] = uint32(w >> 32);
+		}
+		trim();
+	}
+	inline uint32 limb(size_t i) const { return i < limbs.size()? limbs[i] : 0; }
+	inline void trim(){ 
+		while(!limbs.empty() && limbs.back() == 0) limbs.pop_back(); 
+	}
+	inline bool isZero() const { return limbs.empty(); }
+	inline size_t bits() const {
+		if(limbs.empty()) return 0;
+		size_t result = (limbs.size() - 1)*32;
+		for(auto top = limbs.back();top;top >>= 1) result++;
+		return result;
+	}
+	inline bool bit(size_t i) const { return ((limb(i/32) >> (i%32)) & 1) != 0; }
+
+	void store(BigInt& dest,bool isNegative) const {
+		size_t n = (limbs.size() + 1)/2;
+		if(dest.wordCount > 1) dest.freeWords();
+		if(n <= 1){
+			dest.u64 = uint64(limb(0)) | (uint64(limb(1)) << 32);
+			dest.wordCount = 1;
+		} else {
+			dest.words = (uint64*)System::malloc(sizeof(uint64)*n);
+			for(size_t i = 0;i < n;i++) dest.words[i] = uint64(limb(i*2)) | (uint64(limb(i*2+1)) << 32);
+			dest.wordCount = int(n);
+		}
+		dest.negative = isNegative && !dest.isZero();
+	}
+
+	static int compare(const BigIntMagnitude& a,const BigIntMagnitude& b){
+		if(a.limbs.size() != b.limbs.size()) return a.limbs.size() < b.limbs.size()? -1 : 1;
+		for(size_t i = a.limbs.size();i-- > 0;){
+			if(a.limbs[i] != b.limbs[i]) return a.limbs[i] < b.limbs[i]? -1 : 1;
+		}
+		return 0;
+	}
+	static BigIntMagnitude add(const BigIntMagnitude& a,const BigIntMagnitude& b){
+		BigIntMagnitude result;
+		size_t n = std::max(a.limbs.size(),b.limbs.size());
+		result.limbs.resize(n + 1);
+		uint64 carry = 0;
+		for(size_t i = 0;i < n;i++){
+			carry += uint64(a.limb(i)) + uint64(b.limb(i));
+			result.limbs[i] = uint32(carry);
+			carry >>= 32;
+		}
+		result.limbs[n] = uint32(carry);
+		result.trim();
+		return result;
+	}
+	//a must be larger or equal to b
+	static BigIntMagnitude subtract(const BigIntMagnitude& a,const BigIntMagnitude& b){
+		BigIntMagnitude result;
+		result.limbs.resize(a.limbs.size());
+		int64 borrow = 0;
+		for(size_t i = 0;i < a.limbs.size();i++){
+			int64 diff = int64(a.limbs[i]) - int64(b.limb(i)) - borrow;
+			borrow = diff < 0? 1 : 0;
+			result.limbs[i] = uint32(diff + (borrow << 32));
+		}
+		result.trim();
+		return result;
+	}
+	static BigIntMagnitude multiply(const BigIntMagnitude& a,const BigIntMagnitude& b){
+		BigIntMagnitude result;
+		if(a.isZero() || b.isZero()) return result;
+		result.limbs.resize(a.limbs.size() + b.limbs.size(),0);
+		for(size_t i = 0;i < a.limbs.size();i++){
+			uint64 carry = 0;
+			for(size_t j = 0;j < b.limbs.size();j++){
+				carry += uint64(a.limbs[i])*uint64(b.limbs[j]) + uint64(result.limbs[i+j]);
+				result.limbs[i+j] = uint32(carry);
+				carry >>= 32;
+			}
+			result.limbs[i + b.limbs.size()] = uint32(carry);
+		}
+		result.trim();
+		return result;
+	}
+	BigIntMagnitude shiftLeft(size_t shift) const {
+		BigIntMagnitude result;
+		if(isZero()) return result;
+		size_t limbShift = shift/32,bitShift = shift%32;
+		result.limbs.resize(limbs.size() + limbShift + 1,0);
+		for(size_t i = 0;i < limbs.size();i++){
+			uint64 value = uint64(limbs[i]) << bitShift;
+			result.limbs[i + limbShift]     |= uint32(value);
+			result.limbs[i + limbShift + 1] |= uint32(value >> 32);
+		}
+		result.trim();
+		return result;
+	}
+	BigIntMagnitude shiftRight(size_t shift) const {
+		BigIntMagnitude result;
+		size_t limbShift = shift/32,bitShift = shift%32;
+		if(limbShift >= limbs.size()) return result;
+		result.limbs.resize(limbs.size() - limbShift);
+		for(size_t i = 0;i < result.limbs.size();i++){
+			uint64 value = uint64(limb(i + limbShift)) | (uint64(limb(i + limbShift + 1)) << 32);
+			result.limbs[i] = uint32(value >> bitShift);
+		}
+		result.trim();
+		return result;
+	}
+	//Binary long division
+	static void divide(const BigIntMagnitude& a,const BigIntMagnitude& b,BigIntMagnitude& quotient,BigIntMagnitude& remainder){
+		assert(!b.isZero());
+		quotient.limbs.assign(a.limbs.size(),0);
+		remainder.limbs.clear();
+		for(size_t i = a.bits();i-- > 0;){
+			remainder = remainder.shiftLeft(1);
+			if(a.bit(i)){
+				if(remainder.limbs.empty()) remainder.limbs.push_back(1);
+				else remainder.limbs[0] |= 1;
+			}
+			if(compare(remainder,b) >= 0){
+				remainder = subtract(remainder,b);
+				quotient.limbs[i/32] |= (1u << (i%32));
+			}
+		}
+		quotient.trim();
+	}
+	//Divides by a small value and returns the remainder
+	uint32 divideSmall(uint32 divisor){
+		uint64 remainder = 0;
+		for(size_t i = limbs.size();i-- > 0;){
+			uint64 value = (remainder << 32) | limbs[i];
+			limbs[i] = uint32(value / divisor);
+			remainder = value % divisor;
+		}
+		trim();
+		return uint32(remainder);
+	}
+};
+
+void BigInt::addSlow(const BigInt& other,bool subtract){
+	BigIntMagnitude a(*this),b(other);
+	bool otherNegative = subtract? !other.negative : other.negative;
+	if(negative == otherNegative) BigIntMagnitude::add(a,b).store(*this,negative);
+	else if(BigIntMagnitude::compare(a,b) >= 0) BigIntMagnitude::subtract(a,b).store(*this,negative);
+	else BigIntMagnitude::subtract(b,a).store(*this,otherNegative);
+}
+void BigInt::mulSlow(const BigInt& other){
+	BigIntMagnitude::multiply(BigIntMagnitude(*this),BigIntMagnitude(other)).store(*this,negative != other.negative);
+}
+void BigInt::divSlow(const BigInt& other,bool remainder){
+	BigIntMagnitude q,r;
+	BigIntMagnitude::divide(BigIntMagnitude(*this),BigIntMagnitude(other),q,r);
+	if(remainder) r.store(*this,negative);
+	else q.store(*this,negative != other.negative);
+}
+void BigInt::shlSlow(size_t shift){
+	BigIntMagnitude(*this).shiftLeft(shift).store(*this,negative);
+}
+void BigInt::shrSlow(size_t shift){
+	BigIntMagnitude(*this).shiftRight(shift).store(*this,negative);
+}
+
+#define BITWISE_OPERATION(op) \
+	if(wordCount == 1 && other.wordCount == 1){ \
+		u64 op##= other.u64; \
+		if(u64 == 0) negative = false; \
+		return *this; \
+	} \
+	BigIntMagnitude a(*this),b(other); \
+	if(a.limbs.size() < b.limbs.size()) a.limbs.resize(b.limbs.size(),0); \
+	for(size_t i = 0;i < a.limbs.size();i++) a.limbs[i] = a.limbs[i] op b.limb(i); \
+	a.trim(); \
+	a.store(*this,negative); \
+	return *this;
+
+BigInt& BigInt::operator &=(const BigInt& other){
+	BITWISE_OPERATION(&)
+}
+BigInt& BigInt::operator |=(const BigInt& other){
+	BITWISE_OPERATION(|)
+}
+BigInt& BigInt::operator ^=(const BigInt& other){
+	BITWISE_OPERATION(^)
+}
+
+#undef BITWISE_OPERATION
+
 bool BigInt::operator ==(const BigInt& other) const {
 	if(negative != other.negative) return false;
 	if(wordCount != other.wordCount) return false;
-	return u64 == other.u64;
+	if(wordCount == 1) return u64 == other.u64;
+	return memcmp(words,other.words,sizeof(uint64)*wordCount) == 0;
 }
 bool BigInt::operator <(const BigInt& other) const {
 	if(negative && (!other.negative)) return true;
 	else if(other.negative && (!negative)) return false;
-	else if(wordCount < other.wordCount) return true;
-	
-	if(negative) return u64 > other.u64;
-	else return u64 < other.u64;
+
+	//compare the magnitudes
+	bool less;
+	if(wordCount != other.wordCount) less = wordCount < other.wordCount;
+	else {
+		int i = wordCount - 1;
+		while(i > 0 && word(i) == other.word(i)) i--;
+		if(word(i) == other.word(i)) return false;
+		less = word(i) < other.word(i);
+	}
+	return negative? !less : less;
 }
 
 std::ostream& operator<< (std::ostream& stream,const BigInt& integer){
 	if(integer.isNegative()) stream<<'-';
-	stream<<integer.u64;
+	if(integer.wordCount == 1) stream<<integer.u64;
+	else {
+		//Extract the digits in groups of 9
+		BigIntMagnitude magnitude(integer);
+		std::vector<uint32> groups;
+		while(!magnitude.isZero()) groups.push_back(magnitude.divideSmall(1000000000));
+		stream<<groups.back();
+		char digits[10];
+		for(size_t i = groups.size() - 1;i-- > 0;){
+			sprintf(digits,"%09u",groups[i]);
+			stream<<digits;
+		}
+	}
 	return stream;
 }
 
@@ -57,5 +301,50 @@ unittest(bigint){
 	assert(i == BigInt((int64)22));
 	assert(i < BigInt((uint64)88));
 	assert(i <= BigInt((uint64)22));
-}
 
+	//Single word arithmetic
+	BigInt a((int64)-5);
+	a += BigInt((int64)3);
+	assert(a == BigInt((int64)-2));
+	a -= BigInt((int64)-2);
+	assert(a.isZero() && !a.isNegative());
+	a = (int64)7;
+	a *= BigInt((int64)-6);
+	assert(a == BigInt((int64)-42));
+	a /= BigInt((int64)4);
+	assert(a == BigInt((int64)-10));
+	a %= BigInt((int64)3);
+	assert(a == BigInt((int64)-1));
+	assert(BigInt((int64)-3) < BigInt((int64)-2));
+	assert(!(BigInt((int64)-2) < BigInt((int64)-3)));
+
+	//Multi word arithmetic
+	BigInt max = std::numeric_limits<uint64>::max();
+	BigInt big = max;
+	big += BigInt((uint64)1);
+	assert(!big.isWord() && big.word(0) == 0 && big.word(1) == 1);
+	assert(max < big);
+	std::ostringstream stream;
+	stream<<big;
+	assert(stream.str() == "18446744073709551616");
+	BigInt square = big;
+	square *= big;
+	assert(square.word(2) == 1 && square.word(0) == 0 && square.word(1) == 0);
+	square /= big;
+	assert(square == big);
+	square -= BigInt((uint64)1);
+	assert(square.isWord() && square == max);
+	BigInt shifted((uint64)3);
+	shifted <<= 100;
+	assert(!shifted.isWord());
+	BigInt remainder = shifted;
+	remainder %= big;
+	assert(remainder.isZero());
+	shifted >>= 99;
+	assert(shifted == BigInt((uint64)6));
+	BigInt negativeBig = big;
+	negativeBig.changeSign();
+	assert(negativeBig < BigInt((int64)-1));
+	negativeBig += big;
+	assert(negativeBig.isZero() && !negativeBig.isNegative());
+}
@@ -1,5 +1,7 @@
 /**
 * This module provides a big integer strcture
+* The integer is stored as a sign and a magnitude. Magnitudes which fit into one word are stored inline,
+* and the arithmetic on them is done inline, while larger magnitudes are stored in a separate array of words.
 */
 #ifndef ARPHA_BIGINT_H
 #define ARPHA_BIGINT_H
@@ -7,8 +9,8 @@
 struct BigInt {
 //TODO protected:
 	union {
-		uint64 u64;
-		void*  data;
+		uint64  u64;   //The magnitude when wordCount is 1
+		uint64* words; //The words of the magnitude, least significant word first
 	};
 	int wordCount;
 	bool negative;
@@ -17,23 +19,119 @@ public:
 	BigInt();
 	BigInt(uint64 v);
 	BigInt(int64 v);
+	BigInt(const BigInt& other);
+	inline ~BigInt(){ if(wordCount > 1) freeWords(); }
+	BigInt& operator =(const BigInt& other);
 	BigInt& operator =(const uint64 v);
 	BigInt& operator =(const int64 v);
 	BigInt& operator =(const int v);
 
 	bool operator ==(const BigInt& other) const;
 	bool operator <(const BigInt& other) const;
+	inline bool operator !=(const BigInt& other) const { return !(*this == other); }
 	inline bool operator <=(const BigInt& other) const { return (*this < other) || (*this == other); }
 
 	inline bool isNegative() const { return negative; }
 	inline bool isPositive() const { return !negative; }
 	inline bool isZero() const { return wordCount == 1 && u64 == 0; }
+	//Returns true if the magnitude fits into one word(u64)
+	inline bool isWord() const { return wordCount == 1; }
+	inline uint64 word(int i) const { return wordCount == 1? (i == 0? u64 : 0) : (i < wordCount? words[i] : 0); }
 
-	void changeSign(){ negative = !negative; }
+	void changeSign(){ if(!isZero()) negative = !negative; }
+
+	//Arithmetic - the single word case is handled inline
+	inline BigInt& operator +=(const BigInt& other){
+		if(wordCount == 1 && other.wordCount == 1 && addWords(other.u64,other.negative)) return *this;
+		addSlow(other,false);
+		return *this;
+	}
+	inline BigInt& operator -=(const BigInt& other){
+		if(wordCount == 1 && other.wordCount == 1 && addWords(other.u64,!other.negative)) return *this;
+		addSlow(other,true);
+		return *this;
+	}
+	inline BigInt& operator *=(const BigInt& other){
+		if(wordCount == 1 && other.wordCount == 1 && (u64 | other.u64) <= 0xFFFFFFFF){
+			u64 *= other.u64;
+			negative = u64 != 0 && negative != other.negative;
+			return *this;
+		}
+		mulSlow(other);
+		return *this;
+	}
+	//Division truncates towards zero, the divisor can't be zero
+	inline BigInt& operator /=(const BigInt& other){
+		if(wordCount == 1 && other.wordCount == 1){
+			u64 /= other.u64;
+			negative = u64 != 0 && negative != other.negative;
+			return *this;
+		}
+		divSlow(other,false);
+		return *this;
+	}
+	//The remainder has the sign of the dividend, the divisor can't be zero
+	inline BigInt& operator %=(const BigInt& other){
+		if(wordCount == 1 && other.wordCount == 1){
+			u64 %= other.u64;
+			if(u64 == 0) negative = false;
+			return *this;
+		}
+		divSlow(other,true);
+		return *this;
+	}
+	//Shifts shift the magnitude
+	inline BigInt& operator <<=(size_t shift){
+		if(wordCount == 1 && (shift == 0 || (shift < 64 && (u64 >> (64 - shift)) == 0))){
+			u64 <<= shift;
+			return *this;
+		}
+		shlSlow(shift);
+		return *this;
+	}
+	inline BigInt& operator >>=(size_t shift){
+		if(wordCount == 1){
+			u64 = shift < 64? u64 >> shift : 0;
+			if(u64 == 0) negative = false;
+			return *this;
+		}
+		shrSlow(shift);
+		return *this;
+	}
+	//Bitwise operations operate on the magnitudes
+	BigInt& operator &=(const BigInt& other);
+	BigInt& operator |=(const BigInt& other);
+	BigInt& operator ^=(const BigInt& other);
 
 	friend std::ostream& operator<< (std::ostream& stream,const BigInt& integer);
+private:
+	//Adds a signed word to a single word integer, returns false on overflow
+	inline bool addWords(uint64 value,bool isNegative){
+		if(negative == isNegative){
+			uint64 result = u64 + value;
+			if(result < u64) return false;
+			u64 = result;
+		}
+		else if(u64 >= value){
+			u64 -= value;
+			if(u64 == 0) negative = false;
+		}
+		else {
+			u64 = value - u64;
+			negative = isNegative;
+		}
+		return true;
+	}
+	void addSlow(const BigInt& other,bool subtract);
+	void mulSlow(const BigInt& other);
+	void divSlow(const BigInt& other,bool remainder);
+	void shlSlow(size_t shift);
+	void shrSlow(size_t shift);
+	void freeWords();
+
+	friend struct BigIntMagnitude;
 }; 
 
 std::ostream& operator<< (std::ostream& stream,const BigInt& integer);
 
-#endif
\ No newline at end of file
+#endif
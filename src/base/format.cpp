@@ -1,17 +1,107 @@
 #include "format.h"
 
-std::string format(const char *s){
-	std::ostringstream stm;
-    while (*s) {
-        if (*s == '%' && *(++s) != '%')
-            throw std::runtime_error("invalid format string: missing arguments");
-		stm << *s++;
-    }
-	return stm.str();
+namespace formatting {
+
+	const char* next(std::string& dest,const char* s){
+		auto begin = s;
+		while(*s){
+			if(*s == '%'){
+				dest.append(begin,s - begin);
+				++s;
+				if(*s != '%') return *s? s + 1 : s;
+				begin = s;//"%%" outputs '%'
+			}
+			++s;
+		}
+		dest.append(begin,s - begin);
+		return nullptr;
+	}
+
+	void write(std::string& dest,const char* str){
+		dest.append(str);
+	}
+	void write(std::string& dest,const std::string& str){
+		dest.append(str);
+	}
+	void write(std::string& dest,SymbolID symbol){
+		if(!symbol.isNull()) dest.append(symbol.ptr(),symbol.length());
+	}
+	void write(std::string& dest,char c){
+		dest.push_back(c);
+	}
+	void write(std::string& dest,bool value){
+		dest.push_back(value? '1' : '0');
+	}
+
+	static void writeUnsigned(std::string& dest,unsigned long long value,bool negative = false){
+		char buffer[24];
+		char* ptr = buffer + sizeof(buffer);
+		do {
+			*(--ptr) = char('0' + value%10);
+			value/=10;
+		} while(value);
+		if(negative) *(--ptr) = '-';
+		dest.append(ptr,buffer + sizeof(buffer) - ptr);
+	}
+	static void writeSigned(std::string& dest,long long value){
+		if(value < 0) writeUnsigned(dest,0ULL - (unsigned long long)value,true);
+		else writeUnsigned(dest,(unsigned long long)value);
+	}
+	void write(std::string& dest,short value){ writeSigned(dest,value); }
+	void write(std::string& dest,unsigned short value){ writeUnsigned(dest,value); }
+	void write(std::string& dest,int value){ writeSigned(dest,value); }
+	void write(std::string& dest,unsigned int value){ writeUnsigned(dest,value); }
+	void write(std::string& dest,long value){ writeSigned(dest,value); }
+	void write(std::string& dest,unsigned long value){ writeUnsigned(dest,value); }
+	void write(std::string& dest,long long value){ writeSigned(dest,value); }
+	void write(std::string& dest,unsigned long long value){ writeUnsigned(dest,value); }
+
+	StringAppender::int_type StringAppender::overflow(int_type c){
+		if(c != traits_type::eof()) dest->push_back(char(c));
+		return traits_type::not_eof(c);
+	}
+	std::streamsize StringAppender::xsputn(const char* s,std::streamsize n){
+		dest->append(s,size_t(n));
+		return n;
+	}
+
+	//Each thread has a few buffers to allow nested formatting
+	struct ReusedBuffers {
+		enum { Count = 4 };
+		std::string buffers[Count];
+		size_t used;
+	};
+	static THREAD_LOCAL ReusedBuffers* reusedBuffers = nullptr;
+
+	std::string* Reused::acquire(){
+		if(!reusedBuffers){
+			reusedBuffers = new ReusedBuffers;
+			reusedBuffers->used = 0;
+		}
+		if(reusedBuffers->used >= ReusedBuffers::Count) return new std::string;
+		auto buffer = &reusedBuffers->buffers[reusedBuffers->used++];
+		buffer->clear();
+		return buffer;
+	}
+	void Reused::release(std::string* buffer){
+		if(buffer >= reusedBuffers->buffers && buffer < reusedBuffers->buffers + ReusedBuffers::Count) reusedBuffers->used--;
+		else delete buffer;
+	}
 }
 
 unittest(format) {
 	assert(format("Hello world") == "Hello world");
 	assert(format("A %d %s C %c B",12,"KIAI",'_') == "A 12 KIAI C _ B");
 	assert(format("Asc%s","ii") == "Ascii");
-}
\ No newline at end of file
+	assert(format("%s%% %s",-42,std::string("x")) == "-42% x");
+	assert(format("%s %s %s",SymbolID("foo"),SymbolID(),18446744073709551615ULL) == "foo  18446744073709551615");
+	assert(format("%s",1.5) == "1.5");
+
+	assert(std::string(formatting::Reused("%s:%s","a",SymbolID("b"))) == "a:b");
+	bool thrown = false;
+	try { format("%s"); } catch(std::runtime_error&){ thrown = true; }
+	assert(thrown);
+	thrown = false;
+	try { format("",1); } catch(std::logic_error&){ thrown = true; }
+	assert(thrown);
+}
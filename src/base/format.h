@@ -1,42 +1,96 @@
 /**
 * This module contains string formating functions.
 * Usage: format("Hello %s!","world") => "Hello world!"
+* Any character after '%' is a placeholder for the next argument, and "%%" outputs a '%'.
 */
 #ifndef ARPHA_FORMAT_H
 #define ARPHA_FORMAT_H
 
+#include <stdexcept>
+#include <utility>
 #include "base.h"
+#include "symbol.h"
 
-std::string format(const char *s);
-
-//No variadic templates in vc 2010
-#define FmtBody(...) { std::ostringstream stm; while (*s) {  \
-        if (*s == '%' && *(++s) != '%') { \
-            stm << value; \
-            ++s; \
-            stm << format(s,__VA_ARGS__); \
-            return stm.str(); \
-        } \
-        stm << (*s++); \
-    } \
-    throw std::logic_error("extra arguments provided to format!"); \
-} 
-
-template<typename T>
-std::string format(const char *s, T value) FmtBody()
-template<typename T,typename T2>
-std::string format(const char *s, T value,T2 a) FmtBody(a)
-template<typename T,typename T2,typename T3>
-std::string format(const char *s, T value,T2 a,T3 b) FmtBody(a,b)
-template<typename T,typename T2,typename T3,typename T4>
-std::string format(const char *s, T value,T2 a,T3 b,T4 c) FmtBody(a,b,c)
-template<typename T,typename T2,typename T3,typename T4,typename T5>
-std::string format(const char *s, T value,T2 a,T3 b,T4 c,T5 d) FmtBody(a,b,c,d)
-template<typename T,typename T2,typename T3,typename T4,typename T5,typename T6>
-std::string format(const char *s, T value,T2 a,T3 b,T4 c,T5 d,T6 e) FmtBody(a,b,c,d,e)
-
-#undef FmtBody
-
-
-
-#endif
\ No newline at end of file
+namespace formatting {
+
+	//Appends the format string up to the next placeholder and returns the position after it, or null when there are no placeholders left.
+	const char* next(std::string& dest,const char* s);
+
+	//Writes the argument without going through a stream for the common types
+	void write(std::string& dest,const char* str);
+	void write(std::string& dest,const std::string& str);
+	void write(std::string& dest,SymbolID symbol);
+	void write(std::string& dest,char c);
+	void write(std::string& dest,bool value);
+	void write(std::string& dest,short value);
+	void write(std::string& dest,unsigned short value);
+	void write(std::string& dest,int value);
+	void write(std::string& dest,unsigned int value);
+	void write(std::string& dest,long value);
+	void write(std::string& dest,unsigned long value);
+	void write(std::string& dest,long long value);
+	void write(std::string& dest,unsigned long long value);
+
+	//A stream buffer which appends to a string
+	struct StringAppender: std::streambuf {
+		std::string* dest;
+
+		inline StringAppender(std::string* dest) : dest(dest) {}
+	protected:
+		int_type overflow(int_type c);
+		std::streamsize xsputn(const char* s,std::streamsize n);
+	};
+
+	//Other types are written using their stream output operators
+	template<typename T>
+	inline void write(std::string& dest,T& value){
+		StringAppender buffer(&dest);
+		std::ostream stream(&buffer);
+		stream<<value;
+	}
+
+	inline void formatTo(std::string& dest,const char* s){
+		if(next(dest,s)) throw std::runtime_error("invalid format string: missing arguments");
+	}
+	template<typename T,typename... Args>
+	void formatTo(std::string& dest,const char* s,T&& value,Args&&... args){
+		s = next(dest,s);
+		if(!s) throw std::logic_error("extra arguments provided to format!");
+		write(dest,value);
+		formatTo(dest,s,std::forward<Args>(args)...);
+	}
+
+	/**
+		Formats into a buffer which is reused by the next formatting on the same thread,
+		so no memory is allocated once the buffer is large enough.
+		The result is valid until the end of the full expression.
+	*/
+	struct Reused {
+		template<typename... Args>
+		Reused(const char* s,Args&&... args) : buffer(acquire()) {
+			try {
+				formatTo(*buffer,s,std::forward<Args>(args)...);
+			} catch(...){
+				release(buffer);
+				throw;
+			}
+		}
+		inline ~Reused(){ release(buffer); }
+		inline operator const std::string&() const { return *buffer; }
+	private:
+		std::string* buffer;
+
+		static std::string* acquire();
+		static void release(std::string* buffer);
+		NOCOPY(Reused)
+	};
+}
+
+template<typename... Args>
+std::string format(const char* s,Args&&... args){
+	std::string result;
+	formatting::formatTo(result,s,std::forward<Args>(args)...);
+	return result;
+}
+
+#endif
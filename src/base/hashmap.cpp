@@ -0,0 +1,60 @@
+/**
+* The hash map unittests.
+*/
+#include <stdio.h>
+#include "hashmap.h"
+
+unittest(hashMap){
+	HashMap<SymbolID,int> map;
+	assert(map.empty());
+	assert(map.find("foo") == nullptr);
+	char name[32];
+	for(int i = 0;i<100;i++){
+		sprintf(name,"key%d",i);
+		map[SymbolID(name)] = i;
+	}
+	assert(map.size() == 100);
+	for(int i = 0;i<100;i++){
+		sprintf(name,"key%d",i);
+		assert(map.find(name) && *map.find(name) == i);
+	}
+	for(int i = 0;i<100;i+=2){
+		sprintf(name,"key%d",i);
+		assert(map.remove(name));
+		assert(!map.remove(name));
+	}
+	assert(map.size() == 50);
+	int sum = 0;
+	for(auto i = map.begin();i!=map.end();++i) sum+=i->value;
+	assert(sum == 2500);
+	map[SymbolID("key1")] = -1;
+	assert(map.size() == 50 && *map.find("key1") == -1);
+	map.clear();
+	assert(map.empty() && map.begin() == map.end());
+}
+unittest(smallHashMap){
+	SmallHashMap<SymbolID,int,hashing::Hasher<SymbolID>,4> map;
+	char name[32];
+	for(int i = 0;i<4;i++){
+		sprintf(name,"key%d",i);
+		map[SymbolID(name)] = i;
+	}
+	assert(map.size() == 4 && *map.find("key3") == 3 && !map.find("key4"));
+	assert(map.remove("key1") && !map.find("key1") && *map.find("key3") == 3);
+	map[SymbolID("key1")] = 1;
+	//spill to the hash map
+	for(int i = 4;i<20;i++){
+		sprintf(name,"key%d",i);
+		map[SymbolID(name)] = i;
+	}
+	assert(map.size() == 20);
+	int sum = 0;
+	for(auto i = map.begin();i!=map.end();++i) sum+=i->value;
+	assert(sum == 190);
+	for(int i = 0;i<20;i++){
+		sprintf(name,"key%d",i);
+		assert(map.find(name) && *map.find(name) == i);
+	}
+	map.clear();
+	assert(map.empty() && map.begin() == map.end());
+}
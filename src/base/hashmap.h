@@ -0,0 +1,254 @@
+/**
+* Provides a hash map which uses open addressing with linear probing.
+*/
+#ifndef ARPHA_HASHMAP_H
+#define ARPHA_HASHMAP_H
+
+#include "base.h"
+#include "symbol.h"
+
+namespace hashing {
+
+	//Mixes the bits of an integer
+	inline size_t mix(size_t x){
+		x ^= x >> 16;
+		x *= 0x45d9f3b;
+		x ^= x >> 16;
+		return x;
+	}
+	inline size_t combine(size_t seed,size_t value){
+		return seed ^ (value + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+	}
+
+	template<typename T>
+	struct Hasher {
+		static inline size_t hash(const T& value){ return mix(size_t(value)); }
+	};
+	template<typename T>
+	struct Hasher<T*> {
+		static inline size_t hash(const T* value){ return mix(reinterpret_cast<size_t>(value) >> 3); }
+	};
+	template<>
+	struct Hasher<SymbolID> {
+		static inline size_t hash(const SymbolID& value){ return value.hash(); }
+	};
+}
+
+/**
+	An unordered map from keys to values.
+	The keys are hashed using the Hasher and compared using the == operator.
+	Entries live in a single array, so references to values are invalidated by insertions.
+*/
+template<typename K,typename V,typename Hasher = hashing::Hasher<K> >
+struct HashMap {
+	struct Entry {
+		K key;
+		V value;
+		uint8 state;
+	};
+	enum {
+		EMPTY = 0,USED,DELETED
+	};
+private:
+	enum {
+		InitialCapacity = 8 //must be a power of two
+	};
+
+	std::vector<Entry> entries;
+	size_t used;
+	size_t deleted;
+
+	//Returns the index of the entry with the given key, or the index of the slot where the key can be inserted.
+	size_t probe(const K& key,size_t hash) const {
+		size_t mask = entries.size() - 1;
+		size_t i = hash & mask;
+		size_t insertionPoint = size_t(-1);
+		for(;;i = (i + 1) & mask){
+			const Entry& entry = entries[i];
+			if(entry.state == EMPTY) return insertionPoint != size_t(-1)? insertionPoint : i;
+			else if(entry.state == DELETED){
+				if(insertionPoint == size_t(-1)) insertionPoint = i;
+			}
+			else if(entry.key == key) return i;
+		}
+	}
+	void rehash(size_t capacity){
+		std::vector<Entry> old;
+		old.swap(entries);
+		Entry empty = { K(),V(),EMPTY };
+		entries.resize(capacity,empty);
+		deleted = 0;
+		for(auto i = old.begin();i!=old.end();++i){
+			if((*i).state != USED) continue;
+			entries[probe((*i).key,Hasher::hash((*i).key))] = *i;
+		}
+	}
+public:
+	inline HashMap() : used(0),deleted(0) {}
+
+	inline size_t size() const  { return used; }
+	inline bool   empty() const { return used == 0; }
+
+	//Returns null if the key isn't in the map
+	V* find(const K& key) {
+		if(!used) return nullptr;
+		auto i = probe(key,Hasher::hash(key));
+		return entries[i].state == USED? &entries[i].value : nullptr;
+	}
+	inline const V* find(const K& key) const {
+		return const_cast<HashMap*>(this)->find(key);
+	}
+	inline bool contains(const K& key) const {
+		return find(key) != nullptr;
+	}
+
+	//Returns the value for the given key, inserting a default value if the key isn't in the map
+	V& operator[](const K& key){
+		if((used + deleted + 1)*4 > entries.size()*3)
+			rehash(entries.empty()? InitialCapacity : (used + 1)*4 > entries.size()*2 ? entries.size()*2 : entries.size());
+		auto i = probe(key,Hasher::hash(key));
+		auto& entry = entries[i];
+		if(entry.state != USED){
+			if(entry.state == DELETED) deleted--;
+			entry.key = key;
+			entry.value = V();
+			entry.state = USED;
+			used++;
+		}
+		return entry.value;
+	}
+	inline void insert(const K& key,const V& value){
+		(*this)[key] = value;
+	}
+
+	//Returns true if the key was removed
+	bool remove(const K& key){
+		if(!used) return false;
+		auto i = probe(key,Hasher::hash(key));
+		if(entries[i].state != USED) return false;
+		entries[i].state = DELETED;
+		entries[i].value = V();
+		used--;
+		deleted++;
+		return true;
+	}
+
+	void clear(){
+		entries.clear();
+		used = deleted = 0;
+	}
+
+	//Iteration over the entries in the map
+	struct iterator {
+		Entry* ptr;
+		Entry* end;
+
+		inline iterator(Entry* p,Entry* e) : ptr(p),end(e) { skip(); }
+		inline void skip(){ while(ptr != end && ptr->state != USED) ++ptr; }
+		inline Entry& operator*()  const { return *ptr; }
+		inline Entry* operator->() const { return ptr; }
+		inline iterator& operator++(){ ++ptr; skip(); return *this; }
+		inline bool operator==(const iterator& other) const { return ptr == other.ptr; }
+		inline bool operator!=(const iterator& other) const { return ptr != other.ptr; }
+	};
+	inline iterator begin(){
+		auto data = entries.empty()? nullptr : &entries[0];
+		return iterator(data,data + entries.size());
+	}
+	inline iterator end(){
+		auto data = entries.empty()? nullptr : &entries[0];
+		return iterator(data + entries.size(),data + entries.size());
+	}
+};
+
+/**
+	A hash map which stores up to InlineCapacity entries inline and finds them by a linear search.
+	It moves the entries into a HashMap when it grows past that, which makes it suitable for the
+	many maps that hold just a few entries.
+*/
+template<typename K,typename V,typename Hasher = hashing::Hasher<K>,size_t InlineCapacity = 8>
+struct SmallHashMap {
+	typedef typename HashMap<K,V,Hasher>::Entry Entry;
+	typedef typename HashMap<K,V,Hasher>::iterator iterator;
+	typedef HashMap<K,V,Hasher> Map;
+private:
+	Entry  entries[InlineCapacity];
+	size_t count;
+	bool   spilled;
+	Map    map;
+
+	void spill(){
+		for(size_t i = 0;i<count;i++) map.insert(entries[i].key,entries[i].value);
+		count = 0;
+		spilled = true;
+	}
+public:
+	inline SmallHashMap() : count(0),spilled(false) {}
+
+	inline size_t size() const  { return spilled? map.size() : count; }
+	inline bool   empty() const { return size() == 0; }
+
+	//Returns null if the key isn't in the map
+	V* find(const K& key){
+		if(spilled) return map.find(key);
+		for(size_t i = 0;i<count;i++){
+			if(entries[i].key == key) return &entries[i].value;
+		}
+		return nullptr;
+	}
+	inline const V* find(const K& key) const {
+		return const_cast<SmallHashMap*>(this)->find(key);
+	}
+	inline bool contains(const K& key) const {
+		return find(key) != nullptr;
+	}
+
+	//Returns the value for the given key, inserting a default value if the key isn't in the map
+	V& operator[](const K& key){
+		if(!spilled){
+			if(auto value = find(key)) return *value;
+			if(count < InlineCapacity){
+				auto& entry = entries[count++];
+				entry.key   = key;
+				entry.value = V();
+				entry.state = Map::USED;
+				return entry.value;
+			}
+			spill();
+		}
+		return map[key];
+	}
+	inline void insert(const K& key,const V& value){
+		(*this)[key] = value;
+	}
+
+	//Returns true if the key was removed
+	bool remove(const K& key){
+		if(spilled) return map.remove(key);
+		for(size_t i = 0;i<count;i++){
+			if(entries[i].key == key){
+				count--;
+				entries[i] = entries[count];
+				entries[count].value = V();
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void clear(){
+		for(size_t i = 0;i<count;i++) entries[i].value = V();
+		count = 0;
+		spilled = false;
+		map.clear();
+	}
+
+	inline iterator begin(){
+		return spilled? map.begin() : iterator(entries,entries + count);
+	}
+	inline iterator end(){
+		return spilled? map.end() : iterator(entries + count,entries + count);
+	}
+};
+
+#endif
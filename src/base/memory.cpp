@@ -13,6 +13,8 @@ std::ostream& operator<< (std::ostream& stream,const memory::Block& block){
 
 namespace memory {
 
+	using System::ScopedLock;
+
 	Block Block::duplicate() const{
 		assert(ptr());
 		if(length() == 0){
@@ -69,28 +71,138 @@ namespace memory {
 		assert(x.ptr()!=nullptr && x.length() == 0);
 	}
 
+	static Region* regionsRoot = nullptr;
+	static System::Mutex& regionsMutex(){
+		static System::Mutex mutex;
+		return mutex;
+	}
+
+	//The region used for allocations made outside of any module e.g. builtin types.
+	static Region* defaultRegion(){
+		static Region region("<global>");
+		return &region;
+	}
+	//Each thread allocates in its own current region, so modules can be loaded on several threads.
+	static THREAD_LOCAL Region* current = nullptr;
+
+	Region* currentRegion(){
+		return current? current : defaultRegion();
+	}
+	Region* setCurrentRegion(Region* region){
+		auto prev = current;
+		current = region;
+		return prev;
+	}
+	Region* globalRegion(){
+		return defaultRegion();
+	}
+
 	StringLiteralConstructor::StringLiteralConstructor (){
 		_ptr = _start =  buffer;
-		_limit = buffer + 256;
+		_limit = buffer + sizeof(buffer);
+	}
+	StringLiteralConstructor::~StringLiteralConstructor(){
+		if(_start != buffer) System::free(_start);
+	}
+	void StringLiteralConstructor::grow(size_t size){
+		size_t length   = _ptr - _start;
+		size_t capacity = (_limit - _start)*2;
+		while(capacity < length + size) capacity*=2;
+		auto data = (char*)System::malloc(capacity);
+		memcpy(data,_start,length);
+		if(_start != buffer) System::free(_start);
+		_start = data;
+		_ptr   = data + length;
+		_limit = data + capacity;
 	}
 	void  StringLiteralConstructor::append(UnicodeChar c){
-		if(!(_ptr + 4 >= _limit)) _ptr += UTF8::encode(c,(U8Char*)_ptr);
+		if(_ptr + 4 > _limit) grow(4);
+		_ptr += UTF8::encode(c,(U8Char*)_ptr);
+	}
+	void  StringLiteralConstructor::append(const char* str,size_t length){
+		if(_ptr + length > _limit) grow(length);
+		memcpy(_ptr,str,length);
+		_ptr += length;
 	}
 	Block StringLiteralConstructor::toString(){
-		return Block::construct(_start,_ptr - _start).duplicate();
+		size_t length = _ptr - _start;
+		auto data = (char*)allocate(length + 1);
+		memcpy(data,_start,length);
+		data[length] = '\0';
+		return Block::construct(data,length);
 	}
 
-	ManagedDefinition* definitionsRoot = nullptr;
-	size_t managedDefinitionsAllocations = 0;
+	unittest(stringLiteralConstructor){
+		Region region("test");
+		auto prev = setCurrentRegion(&region);
+		StringLiteralConstructor string;
+		for(int i = 0;i<1000;i++) string.append(UnicodeChar('a' + i%26));
+		string.append("xyz",3);
+		auto result = string.toString();
+		assert(result.length() == 1003);
+		assert(result[0] == 'a' && result[26] == 'a' && result[1002] == 'z' && result.ptr()[1003] == '\0');
+		assert(!result.hasOwnership());
+		setCurrentRegion(prev);
+	}
 
-#define SYNCHRONIZED(x) x
+	Region::Region(const char* name) : _name(name),chunks(nullptr),_ptr(nullptr),_limit(nullptr),_allocated(0),_reserved(0),_mutex(nullptr),prev(nullptr) {
+		//Register the region
+		ScopedLock lock(regionsMutex());
+		next = regionsRoot;
+		if(next) next->prev = this;
+		regionsRoot = this;
+	}
+	Region::~Region(){
+		release();
+		setShared(false);
+		ScopedLock lock(regionsMutex());
+		if(prev) prev->next = next;
+		else regionsRoot = next;
+		if(next) next->prev = prev;
+	}
 
-	void* ManagedDefinition::operator new(size_t size){
-		auto p = System::malloc(size);
-		ManagedDefinition* next;
-		SYNCHRONIZED(next = definitionsRoot;definitionsRoot = static_cast<ManagedDefinition*>(p);managedDefinitionsAllocations++);
-		static_cast<ManagedDefinition*>(p)->next = next;
-		return p;
+	void Region::setShared(bool shared){
+		if(shared == isShared()) return;
+		if(shared) _mutex = new System::Mutex();
+		else {
+			delete _mutex;
+			_mutex = nullptr;
+		}
+	}
+	void* Region::allocate(size_t size){
+		if(!_mutex) return bump(size);
+		ScopedLock lock(*_mutex);
+		return bump(size);
+	}
+	void* Region::bump(size_t size){
+		size = (size + Alignment - 1) & ~size_t(Alignment - 1);
+		if(size_t(_limit - _ptr) < size){
+			//Large objects get their own chunk
+			size_t chunkSize = size > ChunkSize/4 ? size : ChunkSize;
+			auto chunk = (Chunk*) System::malloc(Alignment + chunkSize);
+			chunk->next = chunks;
+			chunks = chunk;
+			_reserved += chunkSize;
+			_allocated += size;
+			auto data = reinterpret_cast<char*>(chunk) + Alignment;
+			if(chunkSize != ChunkSize) return data;
+			_ptr   = data;
+			_limit = data + chunkSize;
+		} else _allocated += size;
+		auto result = _ptr;
+		_ptr += size;
+		return result;
+	}
+
+	void Region::release(){
+		Chunk* next;
+		for(auto i = chunks;i!=nullptr;i = next){
+			next = i->next;
+			System::free(i);
+		}
+		chunks = nullptr;
+		_ptr = _limit = nullptr;
+		_allocated = _reserved = 0;
 	}
 
 	//Mark and sweep collector for ManagedDefinitions
@@ -120,34 +232,51 @@ namespace memory {
 	}
 	void init(){
 	}
-	void shutdown(){
-		System::debugPrint(format("Shutting down memory - defs:%s.",managedDefinitionsAllocations));
-		//Delete all the definitions
-		ManagedDefinition* next;
-		for(auto i = definitionsRoot;i!=nullptr;i=next){
-			next = i->__next();
-			System::free(i);
-			managedDefinitionsAllocations--;
+	void dumpRegionStatistics(){
+		ScopedLock lock(regionsMutex());
+		size_t allocated = 0,reserved = 0;
+		for(auto i = regionsRoot;i!=nullptr;i = i->next){
+			System::debugPrint(format("Region '%s' - %s bytes allocated(%s bytes reserved).",i->name(),i->allocatedBytes(),i->reservedBytes()));
+			allocated+=i->allocatedBytes();
+			reserved +=i->reservedBytes();
 		}
-		assert(managedDefinitionsAllocations == 0); //ensure no memory leaks
+		System::debugPrint(format("Regions total - %s bytes allocated(%s bytes reserved).",allocated,reserved));
+	}
+	void shutdown(){
+		System::debugPrint("Shutting down memory.");
+		dumpRegionStatistics();
+		//Free all the regions
+		ScopedLock lock(regionsMutex());
+		for(auto i = regionsRoot;i!=nullptr;i = i->next) i->release();
 	}
 
+	unittest(region){
+		Region region("test");
+		assert(region.allocatedBytes() == 0);
+		auto a = region.allocate(3);
+		auto b = region.allocate(24);
+		assert(a && b && a != b);
+		assert((reinterpret_cast<size_t>(a) % 16) == 0 && (reinterpret_cast<size_t>(b) % 16) == 0);
+		assert(region.allocatedBytes() == 48);
+		auto large = region.allocate(1024*1024);
+		assert(large);
+		memset(large,0,1024*1024);
+		assert(region.allocatedBytes() == 48 + 1024*1024);
+		region.release();
+		assert(region.allocatedBytes() == 0 && region.reservedBytes() == 0);
+	}
 
 	unittest(managedDefinition){
 		struct Def: ManagedDefinition {
 			int i;
 		};
-		assert(definitionsRoot == nullptr);
+		Region region("test");
+		auto prev = setCurrentRegion(&region);
 		auto x = new Def();
 		assert(x);
-		assert(definitionsRoot == x);
-		assert(x->__next() == nullptr);
 		auto y = new Def();
-		assert(y);
-		assert(definitionsRoot == y);
-		assert(y->__next() == x);
-
-		assert(managedDefinitionsAllocations == 2);
+		assert(y && y != x);
+		assert(region.allocatedBytes() >= 2*sizeof(Def));
+		assert(setCurrentRegion(prev) == &region);
 	}
 }
-
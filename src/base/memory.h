@@ -6,6 +6,10 @@
 
 #include "base.h"
 
+namespace System {
+	struct Mutex;
+}
+
 namespace memory {
 
 	/**
@@ -43,37 +47,103 @@ namespace memory {
 	};
 
 
-	//TODO
+	/**
+		Builds the contents of a string literal which has escape sequences.
+		Short literals are built in an inline buffer, which is moved to the heap when it has to grow.
+		The result is copied into the current region and is terminated by a '\0'.
+	*/
 	struct StringLiteralConstructor {
 	private:
 		char  buffer[256];
-		const char* _start;
-		const char* _ptr;
-		const char* _limit;
+		char* _start;
+		char* _ptr;
+		char* _limit;
+
+		void grow(size_t size);
 	public:
 		
 		StringLiteralConstructor();
+		~StringLiteralConstructor();
 		void append(UnicodeChar c);
+		void append(const char* str,size_t length);
 		Block toString();
+
+		NOCOPY(StringLiteralConstructor)
+	};
+
+
+
+	/**
+		A region is a bump pointer allocator which frees all of its memory at once.
+		Each module has its own region, which holds the module's AST nodes, types and scopes.
+	*/
+	struct Region {
+		Region(const char* name);
+		~Region();
+
+		void* allocate(size_t size);
+
+		// A shared region can be allocated from by several threads at once.
+		// It has to be changed while no other thread uses the region.
+		void setShared(bool shared);
+		inline bool isShared() const { return _mutex != nullptr; }
+
+		// Frees all the memory allocated in this region.
+		void release();
+
+		inline const char* name() const { return _name; }
+		inline size_t allocatedBytes() const { return _allocated; }
+		inline size_t reservedBytes() const { return _reserved; }
+	private:
+		struct Chunk {
+			Chunk* next;
+		};
+		enum {
+			ChunkSize = 64*1024,
+			Alignment = 16
+		};
+		void* bump(size_t size);
+
+		const char* _name;
+		Chunk* chunks;
+		char*  _ptr;
+		char*  _limit;
+		size_t _allocated;
+		size_t _reserved;
+		System::Mutex* _mutex;
+
+		Region* prev;
+		Region* next;
+		friend void shutdown();
+		friend void dumpRegionStatistics();
+
+		NOCOPY(Region)
 	};
 
+	// Returns the region used for allocations of AST nodes, types and scopes by the calling thread.
+	Region* currentRegion();
+	// Makes the given region current and returns the previously current region.
+	Region* setCurrentRegion(Region* region);
+	// Returns the region used for allocations made outside of any module.
+	Region* globalRegion();
+
+	inline void* allocate(size_t size){ return currentRegion()->allocate(size); }
 
+	// Prints the number of bytes used by each region.
+	void dumpRegionStatistics();
 
 	/**
 		Base class for prefix and infix definitions
-		Proper memory management to be implemented at a later stage.
+		Definitions are allocated in the current region and are freed together with it.
 	*/
 	struct ManagedDefinition {
-	private:
-		ManagedDefinition* next;
 	public:
 		inline ManagedDefinition(){}
 		
 		virtual void reach(){} //Will be called by GC, need to iterate over object's pointers
-		inline ManagedDefinition* __next(){ return next; }
 
-		void* operator new(size_t size);
-		void operator delete(void* p){}
+		inline void* operator new(size_t size){ return allocate(size); }
+		inline void operator delete(void* p){}
 	protected:
         //NOCOPY(ManagedDefinition)
 	};
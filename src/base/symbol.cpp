@@ -1,79 +1,170 @@
 #include <stdlib.h>
 #include <time.h>
+#include <algorithm>
 #include "symbol.h"
+#include "system.h"
+#include "hashmap.h"
 
-//A global table of unique symbols for fast symbol comparison
+//A table of unique symbols for fast symbol comparison
+//Uses open addressing with linear probing, symbols are stored in a bump arena.
 struct SymbolTable {
 public:
 	SymbolTable();
     ~SymbolTable();
     Symbol* create(const char* src, size_t length);
+	Symbol* create(const char* src, size_t length,size_t hash);
+
+	inline size_t size() const { return count; }
 private:
     enum {
-        hashTableLength = 64
+        initialCapacity = 256, //must be a power of two
+		arenaChunkSize  = 64*1024
     };
-    Symbol* hashTable[hashTableLength];
+	struct ArenaChunk {
+		ArenaChunk* next;
+		char data[0];
+	};
+
+	Symbol* allocate(size_t length);
+	void grow();
+
+    Symbol** hashTable;
+	size_t capacity;
+	size_t count;
+
+	ArenaChunk* chunks;
+	char* arenaPtr;
+	char* arenaLimit;
 };
-SymbolTable symbols;
+/**
+  The global table of symbols, which is split into shards with a lock each.
+  This allows several threads to create symbols at once while keeping the symbols unique.
+*/
+struct ConcurrentSymbolTable {
+public:
+	Symbol* create(const char* src, size_t length);
+private:
+	enum {
+		shardCount = 16
+	};
+	struct Shard {
+		System::Mutex mutex;
+		SymbolTable table;
+	};
+	Shard shards[shardCount];
+};
+
+//Constructed on first use, as symbols can be created by other static initializers(e.g. unittests)
+static ConcurrentSymbolTable& symbols(){
+	static ConcurrentSymbolTable table;
+	return table;
+}
 
 SymbolID::SymbolID(const char* begin,const char* end) { 
 	assert(begin);
 	assert(end);
-	symbol=symbols.create(begin,size_t(end-begin)); 
+	symbol=symbols().create(begin,size_t(end-begin)); 
 }
 SymbolID::SymbolID(const char* str,size_t length) { 
 	assert(str);
-	symbol=symbols.create(str,length); 
+	symbol=symbols().create(str,length); 
 }
 SymbolID::SymbolID(const char* str){
 	assert(str);
-	symbol = symbols.create(str,strlen(str));
+	symbol = symbols().create(str,strlen(str));
 }
 std::ostream& operator<< (std::ostream& stream,const SymbolID symbol){
 	return stream<<(symbol.isNull()?"":symbol.ptr());
 }
 
-//A hash function for a string
-//TODO replace with a proper hash
+//A hash function for a string (FNV-1a)
 inline size_t hashString(const char* src, size_t length) {
-	return length + (size_t) src[0];
+	uint32 hash = 2166136261U;
+	for(const char* end = src + length;src < end;++src){
+		hash ^= uint32(uint8(*src));
+		hash *= 16777619U;
+	}
+	return size_t(hash);
+}
+
+Symbol* SymbolTable::allocate(size_t length){
+	size_t size = sizeof(Symbol) + sizeof(char)*(length + 1);
+	size = (size + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+	if(size_t(arenaLimit - arenaPtr) < size){
+		//Long symbols get their own chunk
+		size_t chunkSize = size > arenaChunkSize/4 ? size : arenaChunkSize;
+		auto chunk = (ArenaChunk*) System::malloc(sizeof(ArenaChunk) + chunkSize);
+		chunk->next = chunks;
+		chunks = chunk;
+		if(chunkSize != arenaChunkSize) return (Symbol*) chunk->data;
+		arenaPtr   = chunk->data;
+		arenaLimit = chunk->data + chunkSize;
+	}
+	auto result = (Symbol*) arenaPtr;
+	arenaPtr += size;
+	return result;
+}
+
+void SymbolTable::grow(){
+	auto oldTable = hashTable;
+	auto oldCapacity = capacity;
+	capacity*=2;
+	hashTable = (Symbol**) System::malloc(sizeof(Symbol*)*capacity);
+	memset(hashTable,0,sizeof(Symbol*)*capacity);
+	for(size_t i = 0;i < oldCapacity;++i){
+		if(!oldTable[i]) continue;
+		size_t j = oldTable[i]->hash & (capacity - 1);
+		while(hashTable[j]) j = (j + 1) & (capacity - 1);
+		hashTable[j] = oldTable[i];
+	}
+	System::free(oldTable);
 }
 
 Symbol* SymbolTable::create(const char* src, size_t length) {
 	if(length == 0) return nullptr;
-	size_t hsh = hashString(src, length) % hashTableLength;
-	//compare strings in current chain
-	Symbol** current = &hashTable[hsh];
-	while ((*current) != nullptr) {
-		if ((*current)->length == length) {
-			if (memcmp((*current)->ptr, src, length) == 0) {
-				return *current;
-			}
-		}
-		current = &((*current)->next);
+	return create(src,length,hashString(src, length));
+}
+
+Symbol* SymbolTable::create(const char* src, size_t length,size_t hsh) {
+	//compare strings in current probe sequence
+	size_t i = hsh & (capacity - 1);
+	for(Symbol* current;(current = hashTable[i]) != nullptr;i = (i + 1) & (capacity - 1)){
+		if(current->hash == hsh && current->length == length && memcmp(current->ptr, src, length) == 0)
+			return current;
 	}
 	//new entry
-	(*current) = (Symbol*) malloc(sizeof (Symbol) + sizeof (char) *(length + 1));
-	(*current)->next = nullptr;
-	(*current)->length = length;
-	memcpy((*current)->ptr, src, length);
-	(*current)->ptr[length] = 0; //null terminate
-	return *current;
+	auto symbol = allocate(length);
+	symbol->hash = hsh;
+	symbol->length = length;
+	memcpy(symbol->ptr, src, length);
+	symbol->ptr[length] = 0; //null terminate
+	hashTable[i] = symbol;
+	//keep the load factor under 3/4
+	if(++count*4 > capacity*3) grow();
+	return symbol;
+}
+
+Symbol* ConcurrentSymbolTable::create(const char* src, size_t length) {
+	if(length == 0) return nullptr;
+	size_t hsh = hashString(src, length);
+	//The shard is picked using the upper bits of the hash, as the lower bits are used by the shard's table.
+	auto& shard = shards[(hsh >> 24) % shardCount];
+	System::ScopedLock lock(shard.mutex);
+	return shard.table.create(src,length,hsh);
 }
 
-SymbolTable::SymbolTable() {
-	for (size_t i = 0; i < hashTableLength; i++) hashTable[i] = nullptr;
+SymbolTable::SymbolTable() : capacity(initialCapacity),count(0),chunks(nullptr),arenaPtr(nullptr),arenaLimit(nullptr) {
+	hashTable = (Symbol**) System::malloc(sizeof(Symbol*)*capacity);
+	memset(hashTable,0,sizeof(Symbol*)*capacity);
 }
 
 SymbolTable::~SymbolTable() {
-	for (size_t i = 0; i < hashTableLength; i++) {
-		Symbol* current = hashTable[i], *next;
-		for (; current != nullptr; current = next) {
-			next = current->next;
-			free(current);
-		}
-		hashTable[i] = nullptr;
+	for(ArenaChunk* chunk = chunks,*next;chunk != nullptr;chunk = next){
+		next = chunk->next;
+		System::free(chunk);
 	}
+	System::free(hashTable);
+	hashTable = nullptr;
 }
 
 //Testing the table
@@ -101,5 +192,62 @@ unittest(symbolTable){
 		assert(x == y);
 		assert(x != z);
 		assert(y != z);
+		assert(x.hash() == y.hash());
+	}
+
+	//Force a couple of resizes and make sure every symbol is still unique
+	std::vector<Symbol*> created;
+	char name[32];
+	for(int j=0;j<5000;j++){
+		sprintf(name,"sym%d",j);
+		created.push_back(symbols.create(name,strlen(name)));
+	}
+	for(int j=0;j<5000;j++){
+		sprintf(name,"sym%d",j);
+		assert(symbols.create(name,strlen(name)) == created[j]);
+	}
+}
+
+//Testing the concurrent table
+namespace {
+	struct SymbolStressTask {
+		ConcurrentSymbolTable* symbols;
+		int seed;
+		std::vector<Symbol*> created;
+	};
+	enum { stressSymbolCount = 2000 };
+	void symbolStressThread(void* argument){
+		auto task = (SymbolStressTask*)argument;
+		task->created.resize(stressSymbolCount);
+		char name[32];
+		//Each thread interns the same names, but in a different order
+		for(int j=0;j<stressSymbolCount;j++){
+			int k = (j*7 + task->seed*13)%stressSymbolCount;
+			sprintf(name,"sym%d",k);
+			task->created[k] = task->symbols->create(name,strlen(name));
+		}
+	}
+}
+unittest(concurrentSymbolTable){
+	auto symbols = new ConcurrentSymbolTable;
+	enum { threadCount = 8 };
+	SymbolStressTask tasks[threadCount];
+	{
+		System::Thread* threads[threadCount];
+		for(int i = 0;i<threadCount;i++){
+			tasks[i].symbols = symbols;
+			tasks[i].seed = i;
+			threads[i] = new System::Thread(&symbolStressThread,&tasks[i]);
+		}
+		for(int i = 0;i<threadCount;i++) delete threads[i];
+	}
+	for(int j=0;j<stressSymbolCount;j++){
+		assert(tasks[0].created[j] != nullptr);
+		for(int i = 1;i<threadCount;i++) assert(tasks[i].created[j] == tasks[0].created[j]);
 	}
+	//Different names must give different symbols
+	std::vector<Symbol*> sorted(tasks[0].created);
+	std::sort(sorted.begin(),sorted.end());
+	for(size_t j = 1;j<sorted.size();j++) assert(sorted[j] != sorted[j-1]);
+	delete symbols;
 }
@@ -8,7 +8,7 @@
 
 //A symbol is a unique string.
 struct Symbol {
-   Symbol* next;
+   size_t hash;
    size_t length;
    char ptr[0];
 };
@@ -33,6 +33,10 @@ struct SymbolID {
 	inline const size_t length() const {
 		return symbol->length;
 	}
+	//The hash of the symbol's string, can be reused by hash maps keyed by symbols.
+	inline size_t hash() const {
+		return symbol? symbol->hash : 0;
+	}
 	inline bool isNull() const{
 		return symbol == nullptr;
 	}
@@ -8,6 +8,14 @@
 #undef max
 #undef min
 static UINT oldcp;
+#else
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <dirent.h>
 #endif
 
 
@@ -24,6 +32,30 @@ void System::shutdown(){
 	#endif
 }
 
+double System::time(){
+	#ifdef  _WIN32
+		LARGE_INTEGER frequency,counter;
+		QueryPerformanceFrequency(&frequency);
+		QueryPerformanceCounter(&counter);
+		return double(counter.QuadPart)/double(frequency.QuadPart);
+	#else
+		timespec now;
+		clock_gettime(CLOCK_MONOTONIC,&now);
+		return double(now.tv_sec) + double(now.tv_nsec)*1e-9;
+	#endif
+}
+
+void System::sleep(uint32 milliseconds){
+	#ifdef  _WIN32
+		Sleep(milliseconds);
+	#else
+		timespec duration;
+		duration.tv_sec  = milliseconds/1000;
+		duration.tv_nsec = long(milliseconds%1000)*1000000;
+		nanosleep(&duration,nullptr);
+	#endif
+}
+
 void* System::malloc(size_t size){
 	return ::malloc(size);
 }
@@ -104,6 +136,56 @@ bool System::directoryExists(const char* filename){
 		return false;
 	#endif
 }
+uint64 System::fileModificationTime(const char* filename){
+	assert(filename);
+	#ifdef  _WIN32
+		UTF16::StringBuffer wfile(filename);
+		WIN32_FILE_ATTRIBUTE_DATA data;
+		if(!GetFileAttributesExW(wfile,GetFileExInfoStandard,&data)) return 0;
+		return (uint64(data.ftLastWriteTime.dwHighDateTime)<<32) | uint64(data.ftLastWriteTime.dwLowDateTime);
+	#else
+		struct stat info;
+		if(stat(filename,&info) != 0) return 0;
+		return uint64(info.st_mtim.tv_sec)*1000000000 + uint64(info.st_mtim.tv_nsec);
+	#endif
+}
+
+void System::findFiles(const char* directory,const char* extension,std::vector<std::string>& files){
+	assert(directory && extension);
+	#ifdef  _WIN32
+		UTF16::StringBuffer wpattern((std::string(directory) + "/*").c_str());
+		WIN32_FIND_DATAW data;
+		auto handle = FindFirstFileW(wpattern,&data);
+		if(handle == INVALID_HANDLE_VALUE) return;
+		do {
+			char name[MAX_PATH*4];
+			if(!WideCharToMultiByte(CP_UTF8,0,data.cFileName,-1,name,sizeof(name),nullptr,nullptr)) continue;
+			if(!strcmp(name,".") || !strcmp(name,"..")) continue;
+			auto path = std::string(directory) + "/" + name;
+			if(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) findFiles(path.c_str(),extension,files);
+			else {
+				auto ext = path::extension(name);
+				if(ext && !strcmp(ext,extension)) files.push_back(path);
+			}
+		} while(FindNextFileW(handle,&data));
+		FindClose(handle);
+	#else
+		auto dir = opendir(directory);
+		if(!dir) return;
+		while(auto entry = readdir(dir)){
+			if(!strcmp(entry->d_name,".") || !strcmp(entry->d_name,"..")) continue;
+			auto path = std::string(directory) + "/" + entry->d_name;
+			struct stat info;
+			if(stat(path.c_str(),&info) != 0) continue;
+			if(S_ISDIR(info.st_mode)) findFiles(path.c_str(),extension,files);
+			else {
+				auto ext = path::extension(entry->d_name);
+				if(ext && !strcmp(ext,extension)) files.push_back(path);
+			}
+		}
+		closedir(dir);
+	#endif
+}
 
 const char* System::fileToString(const char* filename){
 	assert(filename);
@@ -119,6 +201,115 @@ const char* System::fileToString(const char* filename){
 	fclose(file);
 	return (const char*)data;
 }
+System::SourceBuffer* System::SourceBuffer::create(const char* source,size_t length){
+	auto buffer = new SourceBuffer();
+	auto data = (char*)System::malloc(length + 1);
+	memcpy(data,source,length);
+	data[length] = '\0';
+	buffer->_data = data;
+	buffer->_size = length;
+	return buffer;
+}
+
+/**
+* The file is mapped only when its size isn't a multiple of the page size,
+* because then the rest of the last page is filled with zeroes, which gives us the '\0' terminator.
+* Otherwise the file is read into a heap allocated buffer.
+*/
+System::SourceBuffer* System::SourceBuffer::open(const char* filename,bool map){
+	assert(filename);
+	#ifdef  _WIN32
+		UTF16::StringBuffer wfile(filename);
+		HANDLE file = CreateFileW(wfile,GENERIC_READ,FILE_SHARE_READ,nullptr,OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,nullptr);
+		if(file == INVALID_HANDLE_VALUE) return nullptr;
+		LARGE_INTEGER fileSize;
+		if(!GetFileSizeEx(file,&fileSize)){
+			CloseHandle(file);
+			return nullptr;
+		}
+		size_t size = size_t(fileSize.QuadPart);
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		if(map && size != 0 && (size % info.dwPageSize) != 0){
+			HANDLE mapping = CreateFileMappingW(file,nullptr,PAGE_READONLY,0,0,nullptr);
+			if(mapping){
+				auto view = MapViewOfFile(mapping,FILE_MAP_READ,0,0,0);
+				CloseHandle(mapping);//The view keeps the mapping alive
+				if(view){
+					CloseHandle(file);
+					auto buffer = new SourceBuffer();
+					buffer->_data  = (const char*)view;
+					buffer->_size  = size;
+					buffer->mapped = true;
+					return buffer;
+				}
+			}
+		}
+		auto data = (char*)System::malloc(size + 1);
+		DWORD read = 0;
+		if(size && !ReadFile(file,data,DWORD(size),&read,nullptr)) read = 0;
+		CloseHandle(file);
+	#else
+		int file = ::open(filename,O_RDONLY);
+		if(file == -1) return nullptr;
+		struct stat fileStat;
+		if(fstat(file,&fileStat) != 0){
+			close(file);
+			return nullptr;
+		}
+		size_t size = size_t(fileStat.st_size);
+		size_t pageSize = size_t(sysconf(_SC_PAGESIZE));
+		if(map && size != 0 && (size % pageSize) != 0){
+			auto view = mmap(nullptr,size,PROT_READ,MAP_PRIVATE,file,0);
+			if(view != MAP_FAILED){
+				close(file);
+				auto buffer = new SourceBuffer();
+				buffer->_data  = (const char*)view;
+				buffer->_size  = size;
+				buffer->mapped = true;
+				return buffer;
+			}
+		}
+		auto data = (char*)System::malloc(size + 1);
+		size_t read = 0;
+		for(ssize_t n;read < size;read += size_t(n)){
+			n = ::read(file,data + read,size - read);
+			if(n <= 0) break;
+		}
+		close(file);
+	#endif
+	data[read] = '\0';
+	auto buffer = new SourceBuffer();
+	buffer->_data = data;
+	buffer->_size = size_t(read);
+	return buffer;
+}
+
+void System::SourceBuffer::retain(){
+	#ifdef  _WIN32
+		InterlockedIncrement(&references);
+	#else
+		__sync_add_and_fetch(&references,1);
+	#endif
+}
+void System::SourceBuffer::release(){
+	#ifdef  _WIN32
+		auto count = InterlockedDecrement(&references);
+	#else
+		auto count = __sync_sub_and_fetch(&references,1);
+	#endif
+	if(count != 0) return;
+	if(mapped){
+		#ifdef  _WIN32
+			UnmapViewOfFile(_data);
+		#else
+			munmap(const_cast<char*>(_data),_size);
+		#endif
+	}
+	else System::free(const_cast<char*>(_data));
+	delete this;
+}
+
 FILE* System::open(const char* filename,bool write,bool binary){
 	assert(filename);
 	FILE* file = fopen(filename, write? (binary? "wb" : "w") : "r");
@@ -126,6 +317,129 @@ FILE* System::open(const char* filename,bool write,bool binary){
 	return file;
 }
 
+#ifdef  _WIN32
+//Critical sections are always recursive
+System::Mutex::Mutex(bool recursive){
+	handle = System::malloc(sizeof(CRITICAL_SECTION));
+	InitializeCriticalSection((CRITICAL_SECTION*)handle);
+}
+System::Mutex::~Mutex(){
+	DeleteCriticalSection((CRITICAL_SECTION*)handle);
+	System::free(handle);
+}
+void System::Mutex::lock(){
+	EnterCriticalSection((CRITICAL_SECTION*)handle);
+}
+void System::Mutex::unlock(){
+	LeaveCriticalSection((CRITICAL_SECTION*)handle);
+}
+
+System::Condition::Condition(){
+	handle = System::malloc(sizeof(CONDITION_VARIABLE));
+	InitializeConditionVariable((CONDITION_VARIABLE*)handle);
+}
+System::Condition::~Condition(){
+	System::free(handle);
+}
+void System::Condition::wait(Mutex& mutex){
+	SleepConditionVariableCS((CONDITION_VARIABLE*)handle,(CRITICAL_SECTION*)mutex.handle,INFINITE);
+}
+void System::Condition::notify(){
+	WakeConditionVariable((CONDITION_VARIABLE*)handle);
+}
+void System::Condition::notifyAll(){
+	WakeAllConditionVariable((CONDITION_VARIABLE*)handle);
+}
+
+static DWORD WINAPI threadEntry(LPVOID param){
+	auto thread = (System::Thread*)param;
+	thread->function(thread->argument);
+	return 0;
+}
+System::Thread::Thread(void (*function)(void*),void* argument) : function(function),argument(argument) {
+	handle = CreateThread(nullptr,0,&threadEntry,this,0,nullptr);
+	assert(handle);
+}
+System::Thread::~Thread(){
+	if(handle) join();
+}
+void System::Thread::join(){
+	WaitForSingleObject((HANDLE)handle,INFINITE);
+	CloseHandle((HANDLE)handle);
+	handle = nullptr;
+}
+
+size_t System::hardwareThreads(){
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors? size_t(info.dwNumberOfProcessors) : 1;
+}
+#else
+System::Mutex::Mutex(bool recursive){
+	handle = System::malloc(sizeof(pthread_mutex_t));
+	if(recursive){
+		pthread_mutexattr_t attributes;
+		pthread_mutexattr_init(&attributes);
+		pthread_mutexattr_settype(&attributes,PTHREAD_MUTEX_RECURSIVE);
+		pthread_mutex_init((pthread_mutex_t*)handle,&attributes);
+		pthread_mutexattr_destroy(&attributes);
+	}
+	else pthread_mutex_init((pthread_mutex_t*)handle,nullptr);
+}
+System::Mutex::~Mutex(){
+	pthread_mutex_destroy((pthread_mutex_t*)handle);
+	System::free(handle);
+}
+void System::Mutex::lock(){
+	pthread_mutex_lock((pthread_mutex_t*)handle);
+}
+void System::Mutex::unlock(){
+	pthread_mutex_unlock((pthread_mutex_t*)handle);
+}
+
+System::Condition::Condition(){
+	handle = System::malloc(sizeof(pthread_cond_t));
+	pthread_cond_init((pthread_cond_t*)handle,nullptr);
+}
+System::Condition::~Condition(){
+	pthread_cond_destroy((pthread_cond_t*)handle);
+	System::free(handle);
+}
+void System::Condition::wait(Mutex& mutex){
+	pthread_cond_wait((pthread_cond_t*)handle,(pthread_mutex_t*)mutex.handle);
+}
+void System::Condition::notify(){
+	pthread_cond_signal((pthread_cond_t*)handle);
+}
+void System::Condition::notifyAll(){
+	pthread_cond_broadcast((pthread_cond_t*)handle);
+}
+
+static void* threadEntry(void* param){
+	auto thread = (System::Thread*)param;
+	thread->function(thread->argument);
+	return nullptr;
+}
+System::Thread::Thread(void (*function)(void*),void* argument) : function(function),argument(argument) {
+	handle = System::malloc(sizeof(pthread_t));
+	auto error = pthread_create((pthread_t*)handle,nullptr,&threadEntry,this);
+	assert(error == 0);
+}
+System::Thread::~Thread(){
+	if(handle) join();
+}
+void System::Thread::join(){
+	pthread_join(*(pthread_t*)handle,nullptr);
+	System::free(handle);
+	handle = nullptr;
+}
+
+size_t System::hardwareThreads(){
+	auto count = sysconf(_SC_NPROCESSORS_ONLN);
+	return count > 0? size_t(count) : 1;
+}
+#endif
+
 int System::execute(const char* file,const char* param,const char* dir){
 	#ifdef  _WIN32
 		UTF16::StringBuffer wfile(file);
@@ -245,4 +559,11 @@ unittest(System){
 	auto p = System::malloc(16);
 	assert(p);
 	System::free(p);
+
+	auto buffer = System::SourceBuffer::create("foo",3);
+	assert(buffer->size() == 3 && buffer->data()[3] == '\0' && !buffer->isMapped());
+	buffer->retain();
+	buffer->release();
+	assert(strcmp(buffer->data(),"foo") == 0);
+	buffer->release();
 }
\ No newline at end of file
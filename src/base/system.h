@@ -26,6 +26,11 @@ namespace System {
 	OutputBuffer console();
 
 
+	//Returns the time in seconds since an arbitrary point, used for measurements
+	double time();
+	//Suspends the calling thread
+	void sleep(uint32 milliseconds);
+
 	//Heap allocation
 	void* malloc(size_t size);
 	void free(void* ptr);
@@ -34,8 +39,90 @@ namespace System {
 	const char* currentDirectory();
     bool fileExists(const char* filename);
 	bool directoryExists(const char* filename);
+	//Returns the time of the last modification of a file, or 0 if it doesn't exist. The units depend on the platform.
+	uint64 fileModificationTime(const char* filename);
 	const char* fileToString(const char* filename);
 	FILE* open(const char* filename,bool write = false,bool binary = false);
+	//Appends the paths of the files with the given extension in a directory and its subdirectories.
+	void findFiles(const char* directory,const char* extension,std::vector<std::string>& files);
+
+	/**
+		A reference counted, read only buffer with the contents of a source file.
+		The contents are always followed by a '\0'. The file is memory mapped when possible.
+	*/
+	struct SourceBuffer {
+		//Returns null if the file can't be opened.
+		//The file isn't mapped when map is false, so it can be changed while the buffer is alive.
+		static SourceBuffer* open(const char* filename,bool map = true);
+		//Creates a buffer with a copy of the given string.
+		static SourceBuffer* create(const char* source,size_t length);
+
+		inline const char* data() const { return _data; }
+		inline size_t size() const { return _size; }
+		inline bool isMapped() const { return mapped; }
+
+		void retain();
+		void release();
+	private:
+		inline SourceBuffer() : _data(nullptr),_size(0),mapped(false),references(1) {}
+
+		const char* _data;
+		size_t _size;
+		bool   mapped;
+		volatile long references;
+		NOCOPY(SourceBuffer)
+	};
+
+	//Threading
+	struct Mutex {
+		//A recursive mutex can be locked again by the thread which holds it.
+		Mutex(bool recursive = false);
+		~Mutex();
+		void lock();
+		void unlock();
+	private:
+		void* handle;
+		friend struct Condition;
+		NOCOPY(Mutex)
+	};
+
+	//Locks a mutex for the lifetime of the lock object
+	struct ScopedLock {
+		inline ScopedLock(Mutex& mutex) : mutex(mutex) { mutex.lock(); }
+		inline ~ScopedLock(){ mutex.unlock(); }
+	private:
+		Mutex& mutex;
+		NOCOPY(ScopedLock)
+	};
+
+	//Blocks threads until another thread notifies them
+	struct Condition {
+		Condition();
+		~Condition();
+		//The mutex has to be locked by the calling thread, it's unlocked while the thread waits.
+		void wait(Mutex& mutex);
+		void notify();
+		void notifyAll();
+	private:
+		void* handle;
+		NOCOPY(Condition)
+	};
+
+	//Starts executing the function in a new thread
+	struct Thread {
+		Thread(void (*function)(void*),void* argument);
+		~Thread();
+		void join();
+
+		void (*function)(void*);
+		void* argument;
+	private:
+		void* handle;
+		NOCOPY(Thread)
+	};
+
+	//Returns the number of hardware threads(at least 1)
+	size_t hardwareThreads();
 
 	//exe
 	int execute(const char* file,const char* param,const char* dir = nullptr);
@@ -0,0 +1,170 @@
+#include <algorithm>
+#include "threadpool.h"
+#include "memory.h"
+
+//The worker which is executed by the calling thread
+static THREAD_LOCAL void* currentWorker = nullptr;
+
+ThreadPool::ThreadPool(size_t threads) : queued(0),pending(0),next(0),stopping(false) {
+	if(!threads) threads = System::hardwareThreads();
+	workers.reserve(threads);
+	for(size_t i = 0;i<threads;i++){
+		auto worker = new Worker;
+		worker->pool = this;
+		workers.push_back(worker);
+	}
+	//The workers can steal from each other, so they are started once all of them exist
+	for(auto i = workers.begin();i!=workers.end();++i) (*i)->thread = new System::Thread(&work,*i);
+}
+ThreadPool::~ThreadPool(){
+	wait();
+	{
+		System::ScopedLock lock(mutex);
+		stopping = true;
+		available.notifyAll();
+	}
+	//The workers can still try to steal from each other until all of them are stopped
+	for(auto i = workers.begin();i!=workers.end();++i) delete (*i)->thread;
+	for(auto i = workers.begin();i!=workers.end();++i) delete *i;
+}
+
+void ThreadPool::add(Function function,void* argument){
+	Task task = { function,argument };
+	auto worker = (Worker*)currentWorker;
+	if(!worker || worker->pool != this){
+		System::ScopedLock lock(mutex);
+		worker = workers[next];
+		next = (next + 1) % workers.size();
+	}
+	{
+		System::ScopedLock lock(worker->mutex);
+		worker->tasks.push_back(task);
+	}
+	System::ScopedLock lock(mutex);
+	queued++;
+	pending++;
+	available.notify();
+}
+void ThreadPool::wait(){
+	System::ScopedLock lock(mutex);
+	while(pending) finished.wait(mutex);
+}
+
+bool ThreadPool::take(Worker* worker,Task& task){
+	{
+		System::ScopedLock lock(worker->mutex);
+		if(worker->tasks.empty()) return false;
+		task = worker->tasks.back();
+		worker->tasks.pop_back();
+	}
+	System::ScopedLock lock(mutex);
+	queued--;
+	return true;
+}
+bool ThreadPool::steal(Worker* thief,Task& task){
+	for(auto i = workers.begin();i!=workers.end();++i){
+		auto victim = *i;
+		if(victim == thief) continue;
+		{
+			System::ScopedLock lock(victim->mutex);
+			if(victim->tasks.empty()) continue;
+			task = victim->tasks.front();
+			victim->tasks.pop_front();
+		}
+		System::ScopedLock lock(mutex);
+		queued--;
+		return true;
+	}
+	return false;
+}
+
+void ThreadPool::work(void* argument){
+	auto worker = (Worker*)argument;
+	auto pool = worker->pool;
+	currentWorker = worker;
+	for(;;){
+		Task task;
+		if(pool->take(worker,task) || pool->steal(worker,task)){
+			task.function(task.argument);
+
+			System::ScopedLock lock(pool->mutex);
+			pool->pending--;
+			if(!pool->pending) pool->finished.notifyAll();
+			continue;
+		}
+		//The queued counter is changed under the pool's mutex, so a task can't be queued unnoticed while the worker goes to sleep
+		System::ScopedLock lock(pool->mutex);
+		while(!pool->queued && !pool->stopping) pool->available.wait(pool->mutex);
+		if(!pool->queued) break;
+	}
+	currentWorker = nullptr;
+}
+
+struct ThreadPoolTest {
+	ThreadPool* pool;
+	System::Mutex mutex;
+	int executed;
+};
+struct ThreadPoolTestNode {
+	ThreadPoolTest* test;
+	int depth;
+};
+static void threadPoolTestTask(void* argument){
+	auto node = (ThreadPoolTestNode*)argument;
+	{
+		System::ScopedLock lock(node->test->mutex);
+		node->test->executed++;
+	}
+	//Every task queues two more until the depth runs out
+	if(node->depth){
+		for(int i = 0;i<2;i++){
+			auto child = new ThreadPoolTestNode;
+			child->test  = node->test;
+			child->depth = node->depth - 1;
+			node->test->pool->add(&threadPoolTestTask,child);
+		}
+	}
+	delete node;
+}
+
+unittest(threadPool){
+	ThreadPool pool(4);
+	ThreadPoolTest test;
+	test.pool = &pool;
+	test.executed = 0;
+	auto root = new ThreadPoolTestNode;
+	root->test  = &test;
+	root->depth = 9;
+	pool.add(&threadPoolTestTask,root);
+	pool.wait();
+	assert(test.executed == (1<<10) - 1);
+}
+
+struct SharedRegionTestTask {
+	memory::Region* region;
+	void* allocations[256];
+};
+static void sharedRegionTestTask(void* argument){
+	auto task = (SharedRegionTestTask*)argument;
+	for(size_t i = 0;i<256;i++) task->allocations[i] = task->region->allocate(i%2? 24 : 5000);
+}
+
+unittest(sharedRegion){
+	memory::Region region("test");
+	region.setShared(true);
+	std::vector<SharedRegionTestTask> tasks(16);
+	{
+		ThreadPool pool(4);
+		for(auto i = tasks.begin();i!=tasks.end();++i){
+			(*i).region = &region;
+			pool.add(&sharedRegionTestTask,&(*i));
+		}
+		pool.wait();
+	}
+	region.setShared(false);
+	std::vector<void*> allocations;
+	for(auto i = tasks.begin();i!=tasks.end();++i) allocations.insert(allocations.end(),(*i).allocations,(*i).allocations + 256);
+	std::sort(allocations.begin(),allocations.end());
+	assert(std::adjacent_find(allocations.begin(),allocations.end()) == allocations.end());
+	assert(region.allocatedBytes() == 16*128*(32 + 5008));
+}
@@ -0,0 +1,55 @@
+/**
+* Provides a pool of worker threads which execute queued tasks.
+* Each worker has its own queue of tasks. The tasks which are queued by a worker go to the back of its own queue and
+* the worker takes them from the back, so the related tasks run on the same thread. An idle worker steals
+* the oldest task from the front of another worker's queue.
+*/
+#ifndef ARPHA_THREADPOOL_H
+#define ARPHA_THREADPOOL_H
+
+#include <deque>
+#include "base.h"
+#include "system.h"
+
+struct ThreadPool {
+	typedef void (*Function)(void*);
+
+	//Starts the given number of worker threads, or one per hardware thread when it's 0.
+	ThreadPool(size_t threads = 0);
+	//Waits for the queued tasks to finish and stops the workers.
+	~ThreadPool();
+
+	//Queues the task, it can be called from a task too.
+	void add(Function function,void* argument);
+	//Blocks until all of the queued tasks, including the ones queued while waiting, are finished.
+	void wait();
+
+	inline size_t size() const { return workers.size(); }
+private:
+	struct Task {
+		Function function;
+		void* argument;
+	};
+	struct Worker {
+		ThreadPool* pool;
+		System::Thread* thread;
+		System::Mutex mutex;
+		std::deque<Task> tasks;
+	};
+	static void work(void* worker);
+	bool take(Worker* worker,Task& task);
+	bool steal(Worker* thief,Task& task);
+
+	std::vector<Worker*> workers;
+	size_t queued;  //The tasks which are waiting in the queues
+	size_t pending; //The tasks which are queued or running
+	size_t next;    //The worker which receives the next task queued from outside of the pool
+	bool   stopping;
+	System::Mutex mutex;
+	System::Condition available;
+	System::Condition finished;
+
+	NOCOPY(ThreadPool)
+};
+
+#endif
@@ -11,6 +11,7 @@ struct Scope;
 #include "base/system.h"
 #include "base/symbol.h"
 #include "syntax/location.h"
+#include "data/data.h"
 
 struct Parser;
 struct Resolver;
@@ -98,6 +99,37 @@ namespace compiler {
 
 
 	extern BlockExpression* generatedFunctions;
+
+	extern bool memoizeMacros; //Reuse the expansions of the pure macros which are invoked with identical constant arguments
+	extern size_t resolveThreads; //The number of threads which resolve the independent function bodies after the declarations
+
+	/**
+		The independent function bodies of a module can be resolved on several threads.
+		The state which the resolvers share - scopes, interned types, specializations, caches and diagnostics -
+		is then guarded by a single recursive lock. The lock is only taken while the bodies are resolved concurrently,
+		and only around the accesses to the shared state, so the matching of the overloads, the trait checks and the
+		resolution of the body's own nodes run in parallel. Creating a specialization holds the lock until it's resolved.
+	*/
+	extern bool concurrentResolution;
+	void lockSharedState();
+	void unlockSharedState();
+
+	struct SharedStateLock {
+		inline SharedStateLock() : locked(concurrentResolution) { if(locked) lockSharedState(); }
+		inline ~SharedStateLock(){ if(locked) unlockSharedState(); }
+	private:
+		bool locked;
+		NOCOPY(SharedStateLock)
+	};
+
+	/**
+		Collects the diagnostics which are reported on the current thread into the buffer, or prints them straight away when it's null.
+		The bodies which are resolved concurrently report into their own buffers, which are printed in the order of the bodies.
+	*/
+	void bufferDiagnostics(std::ostream* buffer);
+
+	extern data::stat::Frontend statistics;
+	void dumpStatistics();
 };
 
 
@@ -105,8 +137,9 @@ namespace compiler {
 #include "base/format.h"
 
 // NB: Macroes are a necessary evil
-#define warning(loc,...) compiler::onWarning(loc,format(__VA_ARGS__))
-#define error(loc,...) compiler::onError(loc,format(__VA_ARGS__))
-#define debug(...) compiler::onDebug(format(__VA_ARGS__))
+// The messages are formatted into reused buffers, and debug messages aren't formatted at all when they aren't reported.
+#define warning(loc,...) compiler::onWarning(loc,formatting::Reused(__VA_ARGS__))
+#define error(loc,...) compiler::onError(loc,formatting::Reused(__VA_ARGS__))
+#define debug(...) (compiler::reportLevel >= compiler::ReportDebug? compiler::onDebug(formatting::Reused(__VA_ARGS__)) : (void)0)
 
 #endif
\ No newline at end of file
@@ -11,6 +11,11 @@ namespace data {
 	struct Options {
 		const char** packagesPaths;
 		size_t       packagesPathsCount;
+		bool         bufferTokens;//Parse the modules from token buffers
+		size_t       loadThreads; //The number of threads which preload the modules, 0 uses all hardware threads and 1(the default) disables preloading
+		bool         incremental; //Record the declarations of the modules, so that the changed modules can be reloaded
+		bool         memoizeMacros;//Reuse the expansions of the pure macros which are invoked with identical constant arguments
+		size_t       resolveThreads;//The number of threads which resolve the independent function bodies after the declarations, 1 resolves them serially
 	};
 
 	namespace ast {
@@ -131,6 +136,21 @@ namespace data {
 			};
 			Optimizations optimizations;
 		};
+
+		//Front end statistics
+		struct Frontend {
+			size_t typesReused;//The number of types which weren't created because an identical type was interned
+			size_t symbolLookups;       //The number of symbol lookups during the resolution
+			size_t symbolLookupCacheHits;//The number of symbol lookups which were found in the resolution cache
+			size_t macroExpansionsMemoized;//The number of the macro expansions which were recorded in the expansion cache
+			size_t macroExpansionCacheHits;//The number of the macro expansions which were reused from the expansion cache
+			size_t overloadResolutions;        //The number of the resolved function calls
+			size_t overloadResolutionCacheHits;//The number of the function calls whose overload was found in the resolution cache
+			size_t traitChecks;        //The number of the checks whether a type satisfies a trait
+			size_t traitCheckCacheHits;//The number of the trait checks which were answered by the trait satisfaction cache
+			size_t bodiesDeferred;//The number of the function bodies which were resolved after the declarations on the thread pool
+			size_t bodiesResolvedConcurrently;//The number of the deferred function bodies which were fully resolved on the thread pool
+		};
 	};
 
 	namespace gen {
@@ -8,6 +8,7 @@
 #include "llvm/Analysis/Passes.h"
 #include "llvm/Target/TargetData.h"
 #include "llvm/Transforms/Scalar.h"
+#include "llvm/Transforms/IPO.h"
 #include "llvm/Target/TargetMachine.h"
 #include "llvm/Target/TargetOptions.h"
 #include "llvm/Support/IRBuilder.h"
@@ -437,7 +438,7 @@ Node* LLVMgenerator::visit(FloatingPointLiteral* node){
 	return node;
 }
 Node* LLVMgenerator::visit(StringLiteral* node){
-	emitCreateLinearSequence(builder.CreateGlobalStringPtr(node->block.ptr()),builder.getInt64(node->block.length()),Type::getCharType(8));
+	emitCreateLinearSequence(builder.CreateGlobalStringPtr(llvm::StringRef(node->block.ptr(),node->block.length())),builder.getInt64(node->block.length()),Type::getCharType(8));
 	return node;
 }
 
@@ -787,7 +788,7 @@ void loadLinearSequence(LLVMgenerator* generator,llvm::Value* operand1,LinearSeq
 std::pair<llvm::Value*,llvm::Value*> LLVMgenerator::generateLinearSequencePair(Node* node){
 	llvm::Value *begin,*end;
 	if(auto str = node->asStringLiteral()){
-		begin = builder.CreateGlobalStringPtr(str->block.ptr());
+		begin = builder.CreateGlobalStringPtr(llvm::StringRef(str->block.ptr(),str->block.length()));
 		end   = builder.CreateGEP(begin,builder.getInt64(str->block.length()));
 	}
 	else {
@@ -804,7 +805,7 @@ llvm::Value* generateLinearSequenceBegin(LLVMgenerator* generator,Node* node){
 }
 bool optimizeLinearSequenceAssignment(LLVMgenerator* generator,Node* src,Node* dest){
 	if(auto str = src->asStringLiteral()){
-		auto begin = generator->builder.CreateGlobalStringPtr(str->block.ptr());
+		auto begin = generator->builder.CreateGlobalStringPtr(llvm::StringRef(str->block.ptr(),str->block.length()));
 		auto ptr   = generator->generatePointerExpression(dest);
 		generator->builder.CreateStore(begin,generator->builder.CreateStructGEP(ptr,0));
 		auto end   = generator->builder.CreateGEP(begin,generator->builder.getInt64(str->block.length()));
@@ -1872,6 +1873,12 @@ namespace gen {
 		
 		LLVMgenerator generator(target,targetMachine,getGlobalContext(),roots,rootCount,module,passManager,round,dllGen);
 		round++;
+		//Fold the functions which are lowered to identical bodies, e.g. the specializations of a generic function over int32 and uint32
+		if(options->optimizationLevel >= 1){
+			PassManager modulePasses;
+			modulePasses.add(createMergeFunctionsPass());
+			modulePasses.run(*module);
+		}
 		module->dump();
 		
 		
@@ -7,6 +7,7 @@
 #include "base/base.h"
 #include "base/symbol.h"
 #include "base/system.h"
+#include "base/threadpool.h"
 #include "compiler.h"
 #include "ast/scope.h"
 #include "ast/node.h"
@@ -24,10 +25,12 @@
 namespace arpha {
 	void defineCoreSyntax(Scope* scope);
 
-	BlockExpression* parseModule(Parser* parser,BlockExpression* block);
+	//Appends the ranges of the tokens of the top level declarations when the parser has a token buffer
+	BlockExpression* parseModule(Parser* parser,BlockExpression* block,std::vector<std::pair<size_t,size_t> >* declarations = nullptr);
 };
 
 void runTests();
+void runBenchmarks(const char* packagesDirectory);
 
 namespace {
 	System::OutputBuffer dumpToConsole;
@@ -47,6 +50,7 @@ Dumper Dumper::console(){
 
 Dumper::Dumper(std::ostream* stream) {
 	this->stream = stream;
+	indentation = 0;
 	flags = IS_STREAM;
 }
 void Dumper::print(const char* str){
@@ -73,7 +77,24 @@ namespace compiler {
 		Node*  body;
 		std::map<std::string,Package>::iterator package;
 		size_t errorCount;
-		const char* src;
+		System::SourceBuffer* source;//Retained for the lifetime of the module, so that diagnostics and literals can refer to it
+		memory::Region* region;//The module's AST, types and scopes are allocated here
+		std::vector<size_t> lineStarts;//The offsets of the lines in the source, built when the first diagnostic is shown
+
+		//The incremental mode
+		struct Declaration {
+			size_t length;//The number of tokens
+			size_t hash;
+		};
+		std::vector<Declaration> declarations;//The top level declarations in the order of their tokens
+		std::vector<std::string> importers;//The modules which import this module
+		//The sources of the previous versions. Their regions aren't freed either, and the global caches
+		//(macro expansions, specialization arguments) can still refer to the string literals sliced from them.
+		std::vector<System::SourceBuffer*> retiredSources;
+		uint64 modificationTime;
+		bool   stale;//The module has to be parsed again because a module which it imports was changed
+
+		const char* line(int index);
 	};
 	typedef std::map<std::string,Module>::iterator ModulePtr;
 	
@@ -89,9 +110,41 @@ namespace compiler {
 	std::string packageDir;
 	const char** rootImportDirectory;
 	size_t rootImportDirectoryCount;
+	bool   bufferTokens;
+	size_t loadThreads;
+	bool   incremental = false;
+	bool   memoizeMacros = false;
+	size_t resolveThreads = 1;
+	bool   concurrentResolution = false;
+
+	static System::Mutex& sharedStateMutex(){
+		static System::Mutex mutex(true);
+		return mutex;
+	}
+	void lockSharedState(){
+		sharedStateMutex().lock();
+	}
+	void unlockSharedState(){
+		sharedStateMutex().unlock();
+	}
 
 	std::map<std::string,void (*)(Scope*)> postCallbacks;
 
+	//Returns the start of the given line in the source or the end of the source if there is no such line.
+	const char* Module::line(int index){
+		auto src = source->data();
+		auto end = src + source->size();
+		if(lineStarts.empty()){
+			lineStarts.push_back(0);
+			for(auto i = src;(i = (const char*)memchr(i,'\n',size_t(end - i))) != nullptr;){
+				++i;
+				lineStarts.push_back(size_t(i - src));
+			}
+		}
+		if(index < 0 || size_t(index) >= lineStarts.size()) return end;
+		return src + lineStarts[index];
+	}
+
 	ModulePtr findByScope(Scope* scope){
 		if(scope == currentModule->second.scope) return currentModule;
 		for(auto i = modules.begin();i!=modules.end();++i){
@@ -114,6 +167,7 @@ namespace compiler {
 	}
 
 	void addGeneratedExpression(Node* expr){
+		SharedStateLock lock;
 		if(!generatedFunctions){
 			generatedFunctions = new BlockExpression;
 			generatedFunctions->label("__gen");
@@ -140,18 +194,185 @@ namespace compiler {
 	}
 
 
-	ModulePtr newModule(const char* path,const char* source,PackagePtr* package= nullptr){
+	//Returns the filename of the module 'name' in the given directory or an empty string if it doesn't exist.
+	//The module is either at 'dir/name.arp' or it's the main module of the package at 'dir/name/<last component of name>.arp'.
+	std::string moduleFilename(const char* dir,const char* name,bool* isPackage = nullptr){
+		auto filename = std::string(dir) + "/" + name + ".arp";
+		if(isPackage) *isPackage = false;
+		if(System::fileExists(filename.c_str())) return filename;
+		filename = std::string(dir) + "/" + name + "/" + System::path::filename(name) + ".arp";
+		if(isPackage) *isPackage = true;
+		if(System::fileExists(filename.c_str())) return filename;
+		return std::string();
+	}
+
+	/**
+		The import discovery pre-pass loads and lexes the modules on a pool of threads before they are parsed.
+		The tokens of each module are scanned for the import statements and the imported modules are queued too,
+		so the whole import graph is lexed in parallel.
+		The parsing can't be done ahead, because the syntax of a module depends on the macros defined by the modules
+		that it imports. So the modules are still parsed and resolved one by one in the order of their imports,
+		using the preloaded sources and tokens.
+	*/
+	struct PreloadedModule {
+		std::string filename;
+		System::SourceBuffer* source;
+		memory::Region* region;
+		TokenBuffer* tokens;//Null when the source has lexing errors, which are reported when the module is lexed again
+		std::vector<std::string> imports;//The filenames of the imported modules
+	};
+	std::map<std::string,PreloadedModule*> preloaded;
+	System::Mutex preloadMutex;
+	ThreadPool* preloadPool = nullptr;
+
+	//Collects the names of the modules imported by 'import [export] [qualified] a.b.c, d'.
+	static void discoverImports(const TokenBuffer* tokens,std::vector<std::string>& names){
+		SymbolID importSymbol("import"),exportSymbol("export"),qualifiedSymbol("qualified"),dot("."),comma(",");
+		auto count = tokens->size();
+		for(size_t i = 0;i<count;i++){
+			if(tokens->kinds[i] != Token::Symbol || tokens->symbols[i] != importSymbol) continue;
+			i++;
+			if(i < count && tokens->kinds[i] == Token::Symbol && tokens->symbols[i] == exportSymbol) i++;
+			if(i < count && tokens->kinds[i] == Token::Symbol && tokens->symbols[i] == qualifiedSymbol) i++;
+			for(;i < count && tokens->kinds[i] == Token::Symbol;i++){
+				std::string path = tokens->symbols[i].ptr();
+				while(i + 2 < count && tokens->symbols[i+1] == dot && tokens->kinds[i+2] == Token::Symbol){
+					path += '/';
+					path += tokens->symbols[i+2].ptr();
+					i += 2;
+				}
+				names.push_back(path);
+				if(i + 1 >= count || tokens->kinds[i+1] != Token::Symbol || tokens->symbols[i+1] != comma) break;
+				i++;
+			}
+		}
+	}
+
+	static void preloadTask(void* argument);
+
+	//Queues the module for preloading unless it's already loaded or queued.
+	static void preload(const std::string& filename){
+		{
+			System::ScopedLock lock(preloadMutex);
+			if(modules.find(filename) != modules.end() || preloaded.find(filename) != preloaded.end()) return;
+		}
+		auto module = new PreloadedModule;
+		module->filename = filename;
+		module->source = nullptr;
+		module->region = nullptr;
+		module->tokens = nullptr;
+		{
+			System::ScopedLock lock(preloadMutex);
+			if(!preloaded.insert(std::make_pair(filename,module)).second){
+				delete module;
+				return;
+			}
+		}
+		preloadPool->add(&preloadTask,module);
+	}
+
+	static void preloadTask(void* argument){
+		auto module = (PreloadedModule*)argument;
+		module->source = System::SourceBuffer::open(module->filename.c_str(),!incremental);
+		if(!module->source) return;
+
+		//The tokens are allocated in the module's region
+		module->region = new memory::Region(module->filename.c_str());
+		auto prevRegion = memory::setCurrentRegion(module->region);
+		module->tokens = Lexer::tokenize(module->source->data());
+		memory::setCurrentRegion(prevRegion);
+		if(!module->tokens) return;
+
+		//Imports are searched in the module's directory and then in the packages directories, like findModule does.
+		std::vector<std::string> names;
+		discoverImports(module->tokens,names);
+		auto directory = System::path::directory(module->filename.c_str());
+		for(auto name = names.begin();name!=names.end();++name){
+			auto filename = moduleFilename(directory.c_str(),name->c_str());
+			for(auto i = rootImportDirectory;filename.empty() && i!= rootImportDirectory + rootImportDirectoryCount;++i)
+				filename = moduleFilename(*i,name->c_str());
+			if(filename.empty()) continue;
+			module->imports.push_back(filename);
+			preload(filename);
+		}
+	}
+
+	//Loads and lexes the given modules and the modules they import.
+	void preloadModules(const std::string* files,size_t count){
+		if(loadThreads == 1) return;
+		ThreadPool pool(loadThreads);
+		preloadPool = &pool;
+		for(size_t i = 0;i<count;i++) preload(files[i]);
+		pool.wait();
+		preloadPool = nullptr;
+	}
+
+	//Frees the preloaded modules which weren't loaded, e.g. the ones whose imports are never reached.
+	void releasePreloadedModules(){
+		for(auto i = preloaded.begin();i!=preloaded.end();++i){
+			auto module = i->second;
+			if(module->source) module->source->release();
+			if(module->tokens) delete module->tokens;
+			if(module->region) delete module->region;
+			delete module;
+		}
+		preloaded.clear();
+	}
+
+	//Returns the preloaded module with the given filename, or null if it wasn't preloaded.
+	static PreloadedModule* findPreloaded(const char* filename){
+		auto module = preloaded.find(filename);
+		return module != preloaded.end()? module->second : nullptr;
+	}
+
+	static void loadModule(ModulePtr module,TokenBuffer* tokens);
+
+	ModulePtr newModule(const char* path,System::SourceBuffer* source,PackagePtr* package= nullptr){
 		Module module = {};
 		auto insertionResult = modules.insert(std::make_pair(std::string(path),module));
+		auto result = insertionResult.first;
+
+		result->second.directory = System::path::directory(path);
+		if(package) result->second.package = *package;
+		else result->second.package = packages.end();
+		result->second.source = source;
+		source->retain();
+		if(incremental) result->second.modificationTime = System::fileModificationTime(path);
+		//The preloaded tokens are already in the module's region
+		TokenBuffer* tokens = nullptr;
+		auto preloadedModule = findPreloaded(path);
+		if(preloadedModule && preloadedModule->source == source && preloadedModule->region){
+			result->second.region = preloadedModule->region;
+			tokens = preloadedModule->tokens;
+			preloadedModule->tokens = nullptr;
+			preloadedModule->region = nullptr;
+		}
+		else result->second.region = new memory::Region(result->first.c_str());
+
+		loadModule(result,tokens);
+		return result;
+	}
+
+	//Records the lengths and the hashes of the module's top level declarations
+	static void recordDeclarations(Module& module,const TokenBuffer* tokens,const std::vector<std::pair<size_t,size_t> >& ranges){
+		module.declarations.clear();
+		module.declarations.reserve(ranges.size());
+		for(auto i = ranges.begin();i!=ranges.end();++i){
+			Module::Declaration declaration = { i->second - i->first,tokens->hash(i->first,i->second) };
+			module.declarations.push_back(declaration);
+		}
+	}
 
+	//Parses and resolves the module's source in the module's region
+	static void loadModule(ModulePtr module,TokenBuffer* tokens){
+		auto path = module->first.c_str();
 		auto prevModule = currentModule;
-		currentModule = insertionResult.first;
+		currentModule = module;
 
-		currentModule->second.directory = System::path::directory(path);
-		if(package) currentModule->second.package = *package;
-		else currentModule->second.package = packages.end();
 		currentModule->second.errorCount = 0;
-		currentModule->second.src = source;
+		currentModule->second.lineStarts.clear();
+		currentModule->second.stale = false;
+		auto prevRegion = memory::setCurrentRegion(currentModule->second.region);
 
 		//module
 		auto block = new BlockExpression();
@@ -174,23 +395,30 @@ namespace compiler {
 		
 		auto prevUnit = _currentUnit;
 		
-		Parser   parser(source,&_currentUnit);
+		//The incremental mode needs the token buffer to record the declarations
+		Parser   parser(currentModule->second.source->data(),&_currentUnit,bufferTokens || incremental,tokens);
 		Resolver resolver(&_currentUnit);
 		_currentUnit.resolver    = &resolver;
 		_currentUnit.interpreter = interpreter;
 		_currentUnit.parser      = &parser;
 		_currentUnit.moduleBody  = block;
 		
-		arpha::parseModule(&parser,block);
+		if(incremental){
+			std::vector<std::pair<size_t,size_t> > declarations;
+			auto buffer = parser.tokenBuffer();
+			arpha::parseModule(&parser,block,&declarations);
+			recordDeclarations(currentModule->second,buffer,declarations);
+		}
+		else arpha::parseModule(&parser,block);
 
 		dumpModule(block);
 		resolver.resolveModule(block);
 
-		currentModule->second.src = nullptr;
+		debug("The module '%s' allocated %s bytes.",currentModule->first,currentModule->second.region->allocatedBytes());
+		memory::setCurrentRegion(prevRegion);
 		//restore old module ptr
 		currentModule = prevModule;
 		_currentUnit = prevUnit;
-		return insertionResult.first;
 	}
 
 	ModulePtr newModuleFromFile(const char* filename,const char* moduleName = nullptr,PackagePtr* package= nullptr){
@@ -201,24 +429,143 @@ namespace compiler {
 			m[index] = '_';
 			moduleName = m.c_str();
 		}
-		auto src = System::fileToString(filename);
-		auto module = newModule(filename,(const char*)src,package);
-		System::free((void*)src);
+		auto preloadedModule = findPreloaded(filename);
+		auto source = preloadedModule && preloadedModule->source? preloadedModule->source : System::SourceBuffer::open(filename,!incremental);
+		assert(source);
+		auto module = newModule(filename,source,package);
+		if(preloadedModule) preloadedModule->source = nullptr;
+		source->release();
 		module->second.body->label(moduleName);
 		return module;
 	}
 
+	/**
+		The incremental mode reloads the modules whose sources were changed.
+		The tokens of the new source are matched with the lengths and the hashes of the module's top level declarations.
+		When all of them are unchanged and only the separators between them were edited, the module keeps its parsed and resolved AST.
+		Otherwise the module is parsed and resolved again, together with the modules which import it, because the resolution
+		rewrites their AST in place with references to the module's definitions. The declarations of a changed module can't be reused
+		on their own, because the parsing of a declaration depends on the macros and the definitions introduced before it.
+		The other modules keep their AST. The regions of the replaced ASTs aren't freed, as the generated functions can refer to them.
+		The sources are read into the heap instead of being mapped, as the files are saved in place while the AST still refers to them.
+	*/
+	static inline bool isSeparator(const TokenBuffer* tokens,size_t i){
+		static SymbolID semicolon(";");
+		return tokens->kinds[i] == Token::Line || (tokens->kinds[i] == Token::Symbol && tokens->symbols[i] == semicolon);
+	}
+
+	//Returns false when the new tokens contain the same declarations with only the separators between them changed
+	static bool declarationsChanged(const Module& module,const TokenBuffer* tokens){
+		auto& declarations = module.declarations;
+		size_t begin = 0,end = tokens->size() - 1;//The last token is Eof
+		size_t first = 0,last = declarations.size();
+		//Match the declarations from the start and then from the end
+		for(;first < last;first++){
+			while(begin < end && isSeparator(tokens,begin)) begin++;
+			auto length = declarations[first].length;
+			if(end - begin < length || tokens->hash(begin,begin + length) != declarations[first].hash) break;
+			begin += length;
+			if(begin < end && !isSeparator(tokens,begin)) return true;
+		}
+		for(;last > first;last--){
+			while(end > begin && isSeparator(tokens,end - 1)) end--;
+			auto length = declarations[last - 1].length;
+			if(end - begin < length || tokens->hash(end - length,end) != declarations[last - 1].hash) break;
+			end -= length;
+			if(end > begin && !isSeparator(tokens,end - 1)) return true;
+		}
+		if(first < last) return true;
+		while(begin < end && isSeparator(tokens,begin)) begin++;
+		return begin != end;
+	}
+
+	static void reparseModule(ModulePtr module,memory::Region* region,TokenBuffer* tokens){
+		auto label = module->second.body->label();
+		module->second.region = region;
+		loadModule(module,tokens);
+		module->second.body->label(label);
+	}
+
+	//Records the declarations separated by the newlines and ';'
+	static void recordSeparatedDeclarations(Module& module,const TokenBuffer* tokens){
+		std::vector<std::pair<size_t,size_t> > ranges;
+		size_t begin = 0;
+		for(size_t i = 0;i<tokens->size();i++){
+			if(tokens->kinds[i] != Token::Eof && !isSeparator(tokens,i)) continue;
+			if(i != begin) ranges.push_back(std::make_pair(begin,i));
+			begin = i + 1;
+		}
+		recordDeclarations(module,tokens,ranges);
+	}
+	unittest(declarationsChanged){
+		Module module;
+		recordSeparatedDeclarations(module,Lexer::tokenize("def f(x) = x\ndef g = 2\n"));
+		assert(!declarationsChanged(module,Lexer::tokenize("def f(x) = x\n\n# comment\ndef g = 2;")));
+		assert(!declarationsChanged(module,Lexer::tokenize("\ndef f(x)  =  x;def g = 2")));
+		assert(declarationsChanged(module,Lexer::tokenize("def f(x) = x + 1\ndef g = 2\n")));
+		assert(declarationsChanged(module,Lexer::tokenize("def g = 2\n")));
+		assert(declarationsChanged(module,Lexer::tokenize("def f(x) = x\ndef h = 3\ndef g = 2\n")));
+		assert(declarationsChanged(module,Lexer::tokenize("def f(x) = x def g = 2\n")));
+	}
+
+	//Marks the modules which import the given module directly or indirectly
+	static void markImportersStale(ModulePtr module,std::vector<ModulePtr>& stale){
+		std::vector<std::string> importers;
+		importers.swap(module->second.importers);//They are recorded again when they are parsed
+		for(auto i = importers.begin();i!=importers.end();++i){
+			auto importer = modules.find(*i);
+			if(importer == modules.end() || importer->second.stale) continue;
+			importer->second.stale = true;
+			stale.push_back(importer);
+			markImportersStale(importer,stale);
+		}
+	}
+
+	//Returns true if the module was parsed again
+	bool reloadModule(ModulePtr module){
+		auto source = System::SourceBuffer::open(module->first.c_str(),false);
+		if(!source) return false;
+		module->second.modificationTime = System::fileModificationTime(module->first.c_str());
+		auto region = new memory::Region(module->first.c_str());
+		auto prevRegion = memory::setCurrentRegion(region);
+		auto tokens = Lexer::tokenize(source->data());
+		memory::setCurrentRegion(prevRegion);
+		if(tokens && !declarationsChanged(module->second,tokens)){
+			//The old source is kept, as the locations in the AST refer to it
+			delete tokens;
+			delete region;
+			source->release();
+			return false;
+		}
+
+		std::vector<ModulePtr> stale;
+		markImportersStale(module,stale);
+		module->second.retiredSources.push_back(module->second.source);
+		module->second.source = source;
+		reparseModule(module,region,tokens);
+		//An importer is parsed again earlier when a module which imports it is parsed
+		for(auto i = stale.begin();i!=stale.end();++i){
+			if((*i)->second.stale) reparseModule(*i,new memory::Region((*i)->first.c_str()),nullptr);
+		}
+		return true;
+	}
+
+	//Reloads the modules whose files were modified after they were loaded
+	void reloadChangedModules(){
+		for(auto i = modules.begin();i!=modules.end();++i){
+			auto time = System::fileModificationTime(i->first.c_str());
+			if(!time || time == i->second.modificationTime) continue;
+			if(reloadModule(i)) System::print(format("The module '%s' was changed and parsed again.\n",i->first));
+			else i->second.modificationTime = time;
+		}
+	}
+
 	//Module importing is done by searching in the appropriate directories
 	Scope* findModuleFromDirectory(const char* dir,const char* name,ModulePtr* relative = nullptr){
-		std::string moduleName;
-		//Try non package way
-		auto filename = std::string(dir) + "/" + name + ".arp";
-		if(!System::fileExists(filename.c_str())){
-			//Try package way
-			filename = std::string(dir) + "/" + name + "/" + System::path::filename(name) + ".arp";
-			if(!System::fileExists(filename.c_str())) return nullptr;
-			else moduleName = std::string(name) + "_" + name;
-		} else moduleName = name;
+		bool isPackage;
+		auto filename = moduleFilename(dir,name,&isPackage);
+		if(filename.empty()) return nullptr;
+		std::string moduleName = isPackage? std::string(name) + "_" + name : std::string(name);
 		//load module
 		auto module = modules.find(filename);
 		if(module == modules.end()){
@@ -237,11 +584,19 @@ namespace compiler {
 				}
 			}
 
-			onDebug(format("A new module %s located at '%s' will be loaded.",name,filename));
+			debug("A new module %s located at '%s' will be loaded.",name,filename);
 			module = newModuleFromFile(filename.c_str(),moduleName.c_str(),&package);
 
 			package->second.modules.push_back(module);
 		}
+		else if(module->second.stale){
+			debug("The module '%s' will be parsed again because a module which it imports was changed.",filename);
+			reparseModule(module,new memory::Region(module->first.c_str()),nullptr);
+		}
+		if(incremental && currentModule != modules.end() && currentModule != module){
+			auto& importers = module->second.importers;
+			if(std::find(importers.begin(),importers.end(),currentModule->first) == importers.end()) importers.push_back(currentModule->first);
+		}
 		return module->second.scope;
 	}
 
@@ -262,6 +617,31 @@ namespace compiler {
 
 	int reportLevel;
 
+	data::stat::Frontend statistics = {};
+
+	void dumpStatistics(){
+		System::debugPrint(format("Types reused by interning: %s.",statistics.typesReused));
+		if(statistics.symbolLookups){
+			System::debugPrint(format("Symbol lookups resolved from the cache: %s of %s(%s%%).",statistics.symbolLookupCacheHits,statistics.symbolLookups,
+				uint64(statistics.symbolLookupCacheHits*100/statistics.symbolLookups)));
+		}
+		if(statistics.overloadResolutions){
+			System::debugPrint(format("Overload resolutions found in the cache: %s of %s(%s%%).",statistics.overloadResolutionCacheHits,statistics.overloadResolutions,
+				uint64(statistics.overloadResolutionCacheHits*100/statistics.overloadResolutions)));
+		}
+		if(statistics.traitChecks){
+			System::debugPrint(format("Trait checks found in the cache: %s of %s(%s%%).",statistics.traitCheckCacheHits,statistics.traitChecks,
+				uint64(statistics.traitCheckCacheHits*100/statistics.traitChecks)));
+		}
+		if(statistics.bodiesDeferred){
+			System::debugPrint(format("Function bodies resolved concurrently: %s of %s.",statistics.bodiesResolvedConcurrently,statistics.bodiesDeferred));
+		}
+		if(statistics.macroExpansionsMemoized){
+			System::debugPrint(format("Macro expansions reused from the cache: %s(%s were recorded).",statistics.macroExpansionCacheHits,statistics.macroExpansionsMemoized));
+			dumpMacroExpansionStatistics();
+		}
+	}
+
 	void init(data::Options* options){
 		interpreter = constructInterpreter(nullptr);
 		currentModule = modules.end();
@@ -269,6 +649,11 @@ namespace compiler {
 		rootImportDirectory      = options->packagesPaths;
 		rootImportDirectoryCount = options->packagesPathsCount;
 		assert(rootImportDirectoryCount);
+		bufferTokens = options->bufferTokens;
+		loadThreads  = options->loadThreads;
+		incremental  = options->incremental;
+		memoizeMacros = options->memoizeMacros;
+		resolveThreads = options->resolveThreads;
 
 		packageDir = rootImportDirectory[0];
 
@@ -277,7 +662,10 @@ namespace compiler {
 		intrinsics::types::startup();
 
 		//Load language definitions.
+		auto core = moduleFilename(packageDir.c_str(),"arpha/arpha");
+		if(!core.empty()) preloadModules(&core,1);
 		findModuleFromDirectory(packageDir.c_str(),"arpha/arpha",nullptr);
+		releasePreloadedModules();
 		//newModuleFromFile((packageDir + "/arpha/arpha.arp").c_str(),"arpha_arpha",nullptr,true);
 
 		reportLevel = ReportDebug;
@@ -294,59 +682,81 @@ namespace compiler {
 		}
 	}
 
+	//The diagnostics which are reported on a thread that resolves a body concurrently go to the body's buffer
+	static THREAD_LOCAL std::ostream* diagnosticsBuffer = nullptr;
+	void bufferDiagnostics(std::ostream* buffer){
+		diagnosticsBuffer = buffer;
+	}
+	static inline std::ostream& diagnostics(){
+		return diagnosticsBuffer? *diagnosticsBuffer : std::cout;
+	}
+
 	void onDebug(const std::string& message){
-		if(reportLevel >= ReportDebug) System::debugPrint(message);
+		SharedStateLock lock;
+		if(reportLevel >= ReportDebug){
+			if(diagnosticsBuffer) (*diagnosticsBuffer)<<"Debug: "<<message<<std::endl;
+			else System::debugPrint(message);
+		}
 	}
 	void showSourceLine(Location& location,size_t offset = 0){
+		auto& out = diagnostics();
 		size_t i;
-		for(i = 0;i<offset;i++) std::cout<<' ';
-		const char* src = currentModule->second.src;
-		for(i = 0;i<location.line();src++){
-			if(*src == '\0') break;
-			else if(*src == '\n') i++;
-		}
-		for(;*src!='\n' && *src!='\r' && *src!='\0';src++) std::cout<<*src;
+		for(i = 0;i<offset;i++) out<<' ';
+		const char* src = currentModule->second.line(location.line());
+		for(;*src!='\n' && *src!='\r' && *src!='\0';src++) out<<*src;
 		if(location.column >= 0){
-			std::cout<< std::endl;
-			for(i = 0;i<offset;i++) std::cout<<' ';
-			for(i = 0;i<location.column;i++) std::cout<<'~';
-			std::cout<<"^";
+			out<< std::endl;
+			for(i = 0;i<offset;i++) out<<' ';
+			for(i = 0;i<location.column;i++) out<<'~';
+			out<<"^";
 		}
-		std::cout<< std::endl;
+		out<< std::endl;
 	}
 	void onError(Location& location,const std::string& message){
+		SharedStateLock lock;
 		if(reportLevel >= ReportErrors){
-			std::cout<< currentModule->first << '(' << location.line() << ':' << location.column << ')' <<": Error: " << message << std::endl;
+			diagnostics()<< currentModule->first << '(' << location.line() << ':' << location.column << ')' <<": Error: " << message << std::endl;
 			showSourceLine(location,currentModule->first.size());
 		}
 		currentModule->second.errorCount++;
 	}
 	void onError(Node* node,const std::string& message){
+		SharedStateLock lock;
 		auto location = node->location();
 		if(reportLevel >= ReportErrors)
-			std::cout<< currentModule->first << '(' << location.line() << ':' << location.column << ')' <<": Error: " << message << std::endl;
+			diagnostics()<< currentModule->first << '(' << location.line() << ':' << location.column << ')' <<": Error: " << message << std::endl;
 		currentModule->second.errorCount++;
 	}
 	void intrinsicFatalError(Location& location,const std::string& message){
-		std::cout<< currentModule->first << '(' << location.line() << ':' << location.column << ')' <<": INTRINSIC FATAL ERROR: " << message << std::endl;
-		std::cout<<"The compiler will now exit!"<<std::endl;
+		SharedStateLock lock;
+		diagnostics()<< currentModule->first << '(' << location.line() << ':' << location.column << ')' <<": INTRINSIC FATAL ERROR: " << message << std::endl;
+		diagnostics()<<"The compiler will now exit!"<<std::endl;
 		currentModule->second.errorCount++;
 	}
 	void headError(Location& location,const std::string& message){
-		std::cout<< currentModule->first << '(' << location.line() << ':' << location.column << ')' <<": Error: " << message << std::endl;
+		SharedStateLock lock;
+		diagnostics()<< currentModule->first << '(' << location.line() << ':' << location.column << ')' <<": Error: " << message << std::endl;
 		currentModule->second.errorCount++;
 	}
 	void subError(Location& location,const std::string& message){
-		for(size_t i = 0;i<currentModule->first.size();i++) std::cout<<' ';
-		std::cout<< '(' << location.line() << ':' << location.column << ')' <<": " << message << std::endl;
+		SharedStateLock lock;
+		for(size_t i = 0;i<currentModule->first.size();i++) diagnostics()<<' ';
+		diagnostics()<< '(' << location.line() << ':' << location.column << ')' <<": " << message << std::endl;
 		showSourceLine(location,currentModule->first.size());
 		currentModule->second.errorCount++;
 	}
 	void onAmbiguosDeclarationError(Node* declaration){
-
+		SharedStateLock lock;
 
 		if(auto function = declaration->asFunction()){
 			auto module = findByScope(function->owner()->moduleScope());
+			if(diagnosticsBuffer){
+				(*diagnosticsBuffer)<<format("\t%s(%d:%d): ",module->first,function->location().lineNumber,function->location().column);
+				Dumper dumper(diagnosticsBuffer);
+				function->dumpDeclaration(dumper);
+				(*diagnosticsBuffer)<<'\n';
+				return;
+			}
 			System::print(format("\t%s(%d:%d): ",module->first,function->location().lineNumber,function->location().column));
 			//for(auto i = function->arguments.begin();i!=function->arguments.end();++i)
 			//	System::print(format("%s %s%c ",(*i)->label(),(*i)->type,(i+1)==function->arguments.end()? ')':','));
@@ -357,7 +767,8 @@ namespace compiler {
 		} else assert(false);
 	}
 	void onWarning(Location& location,const std::string& message){
-		std::cout<< currentModule->first << '(' << location.line() << ':' << location.column << ')' <<": Warning: " << message << std::endl;
+		SharedStateLock lock;
+		diagnostics()<< currentModule->first << '(' << location.line() << ':' << location.column << ')' <<": Warning: " << message << std::endl;
 		showSourceLine(location,currentModule->first.size());
 	}
 
@@ -436,7 +847,7 @@ unittest(cl){
 	assert(stringsEqualAnyCase("foo1","FoO1"));
 }
 
-ClOption clOptions[]={ClOption("m32","m64"),ClOption("m64","m32"),ClOption("arch",1),ClOption("o",1),ClOption("asm"),ClOption("llvmbc"),ClOption("enable-unsafe-fp-math")};
+ClOption clOptions[]={ClOption("m32","m64"),ClOption("m64","m32"),ClOption("arch",1),ClOption("o",1),ClOption("asm"),ClOption("llvmbc"),ClOption("enable-unsafe-fp-math"),ClOption("buffer-tokens"),ClOption("load-threads",1),ClOption("memoize-macros"),ClOption("resolve-threads",1)};
 ClOption* findOption(const char* cl){
 	auto end = clOptions+ (sizeof(clOptions) / sizeof(ClOption));
 	for(auto i = clOptions;i!=end;i++){
@@ -488,6 +899,18 @@ struct ClOptionApplier {
 		else if(stringsEqualAnyCase(option,"asm"))    *outputFormat |= data::gen::native::ASSEMBLY;
 		else if(stringsEqualAnyCase(option,"llvmbc")) *outputFormat |= gen::LLVMBackend::OUTPUT_BC;
 		else if(stringsEqualAnyCase(option,"enable-unsafe-fp-math")) genOptions->unsafeFPmath = true;
+		else if(stringsEqualAnyCase(option,"buffer-tokens")) options->bufferTokens = true;
+		else if(stringsEqualAnyCase(option,"memoize-macros")) options->memoizeMacros = true;
+		else if(stringsEqualAnyCase(option,"load-threads")){
+			auto threads = atoi(param);
+			if(threads > 0) options->loadThreads = size_t(threads);
+			else paramError(option,param,"a positive number");
+		}
+		else if(stringsEqualAnyCase(option,"resolve-threads")){
+			auto threads = atoi(param);
+			if(threads > 0) options->resolveThreads = size_t(threads);
+			else paramError(option,param,"a positive number");
+		}
 	}
 };
 
@@ -522,7 +945,7 @@ int main(int argc, const char * argv[]){
 
 	//initilize default settings
 	const char* pp = "D:/alex/projects/parser/packages";
-	data::Options options = { &pp,1 };
+	data::Options options = { &pp,1,false,1,false,false,1 };
 
 	data::gen::Options genOptions;
 	genOptions.optimizationLevel = -1;
@@ -584,8 +1007,15 @@ int main(int argc, const char * argv[]){
 	gen::LLVMBackend     backend(&target,&genOptions);
 	gen::Linker          linker(&target,&genOptions);
 
+	//The watch mode reloads the modules when they're changed
+	if(operation == "watch") options.incremental = true;
 	compiler::init(&options);
 	//runTests();
+	if(operation == "benchmark"){
+		compiler::reportLevel = compiler::ReportErrors;
+		runBenchmarks(options.packagesPaths[0]);
+		return 0;
+	}
 	
 	bool run  = false;
 	bool link = true;
@@ -598,12 +1028,33 @@ int main(int argc, const char * argv[]){
 		compiler::testing = true;
 		operation = "build";
 	}
+	if(operation == "watch"){
+		if(files.size() < 1){
+			onFatalError(format("No files provided!"));
+		}
+		compiler::reportLevel = compiler::ReportErrors;
+
+		for(auto f = files.begin();f!=files.end();++f){
+			if(strcmp(System::path::extension((*f).c_str()),"arp") == 0) compiler::newModuleFromFile((*f).c_str());
+		}
+		System::print("Watching the modules for changes...\n");
+		while(true){
+			System::sleep(500);
+			compiler::reloadChangedModules();
+		}
+	}
 	if(operation == "build"){
 		if(files.size() < 1){
 			onFatalError(format("No files provided!"));
 		}
 		compiler::reportLevel = compiler::ReportErrors;
 
+		std::vector<std::string> sources;
+		for(auto f = files.begin();f!=files.end();++f){
+			if(strcmp(System::path::extension((*f).c_str()),"arp") == 0) sources.push_back(*f);
+		}
+		if(!sources.empty()) compiler::preloadModules(&sources[0],sources.size());
+
 		for(auto f = files.begin();f!=files.end();++f){
 			auto file = (*f).c_str();
 
@@ -618,6 +1069,7 @@ int main(int argc, const char * argv[]){
 				*f = backend.generateModule(module->second.body,dir.c_str(),name.c_str(),outputFormat);
 			}
 		}
+		compiler::releasePreloadedModules();
 		if(hasErrors) return -1;
 
 		buildPackages(&target,backend,link? &linker : nullptr,files);
@@ -643,7 +1095,9 @@ int main(int argc, const char * argv[]){
 			std::cout<<"> ";
 			std::cin.getline(buf,1024);
 			if(buf[0]=='\0'){
-				auto mod = compiler::newModule("source",source.c_str());
+				auto buffer = System::SourceBuffer::create(source.c_str(),source.length());
+				auto mod = compiler::newModule("source",buffer);
+				buffer->release();
 				
 				if(compiler::generatedFunctions){
 					debug("Generated functions - %s",compiler::generatedFunctions);
@@ -669,6 +1123,7 @@ int main(int argc, const char * argv[]){
 		}
 	}
 
+	compiler::dumpStatistics();
 	memory::shutdown();
 	System::shutdown();
 			
@@ -2,7 +2,7 @@
 * This module implements arpha's core syntax macroes
 */
 
-
+#include <algorithm>
 #include "../base/symbol.h"
 #include "../compiler.h"
 #include "../ast/scope.h"
@@ -30,7 +30,8 @@ namespace arpha {
 	}
 
 	void defineCoreSyntax(Scope* scope);
-	BlockExpression* parseModule(Parser* parser,BlockExpression* block);
+	//Appends the ranges of the tokens of the top level declarations when the parser has a token buffer
+	BlockExpression* parseModule(Parser* parser,BlockExpression* block,std::vector<std::pair<size_t,size_t> >* declarations = nullptr);
 };
 
 
@@ -124,11 +125,38 @@ BlockParser* blockParser;
 
 }
 
+namespace {
+
+//Records the range of tokens of each top level declaration in a module which is parsed from a token buffer
+struct ModuleChildParser : BlockParser::BlockChildParser {
+	std::vector<std::pair<size_t,size_t> >* declarations;
+	TokenBuffer* buffer;
+
+	ModuleChildParser(BlockExpression* block,Parser* parser,std::vector<std::pair<size_t,size_t> >* declarations) : BlockChildParser(block),
+		declarations(parser->isBuffered()? declarations : nullptr),buffer(parser->tokenBuffer()) {}
+	bool operator ()(Parser* parser){
+		auto begin = parser->tokenPosition();
+		auto result = BlockChildParser::operator()(parser);
+		if(declarations){
+			parser->peek();
+			//A declaration which ends in a different buffer(i.e. in a mixin) doesn't have a range
+			if(parser->tokenBuffer() == buffer) declarations->push_back(std::make_pair(begin,parser->tokenPosition()));
+			else {
+				declarations->clear();
+				declarations = nullptr;
+			}
+		}
+		return result;
+	}
+};
+
+}
+
 // parses an arpha module
 // ::= {EOF|block.body EOF}
-BlockExpression* arpha::parseModule(Parser* parser,BlockExpression* block){
+BlockExpression* arpha::parseModule(Parser* parser,BlockExpression* block,std::vector<std::pair<size_t,size_t> >* declarations){
 	parser->enterBlock(block);
-	blockParser->body(parser,BlockParser::BlockChildParser(block),false,true); //Ignore '}' and end on EOF
+	blockParser->body(parser,ModuleChildParser(block,parser,declarations),false,true); //Ignore '}' and end on EOF
 	parser->leaveBlock();
 	return block;
 }
@@ -813,7 +841,7 @@ struct TypeParser: IntrinsicPrefixMacro {
 
 				ParameterTypeSuggestion self = { "self",nullptr };
 				if(!templateDeclaration){
-					self.expression = new TypeReference(new Type(Type::POINTER,record));
+					self.expression = new TypeReference(Type::getPointerType(record));
 				}
 				//TODO
 				else self.expression = new PointerOperation(new UnresolvedSymbol(parser->previousLocation(),templateDeclaration->label()),PointerOperation::DEREFERENCE_OR_TYPE);
@@ -1115,7 +1143,8 @@ struct CaptureParser : IntrinsicPrefixMacro {
 
 	struct QuasiParser : IntrinsicPrefixMacro {
 		Scope* parentScope;
-		QuasiParser(Scope* scope) : IntrinsicPrefixMacro("$"),parentScope(scope) {}
+		NodeReference::Splices* splices;
+		QuasiParser(Scope* scope) : IntrinsicPrefixMacro("$"),parentScope(scope),splices(nullptr) {}
 		Node* parse(Parser* parser){
 			//Give access to macroes variables
 			auto symbol = parser->expectName();
@@ -1123,6 +1152,8 @@ struct CaptureParser : IntrinsicPrefixMacro {
 			if(auto v = expr->asVariableReference()){
 				//TODO this safety check is required!
 				//if(v->variable->functionOwner() != parentScope->functionOwner()) error(v,"Can't $ a variable that is outside the current function!");
+				auto& variables = splices->variables;
+				if(std::find(variables.begin(),variables.end(),v->variable) == variables.end()) variables.push_back(v->variable);
 			}else error(expr,"Expected a variable reference after '$'!");
 			return expr;
 		}
@@ -1137,15 +1168,17 @@ struct CaptureParser : IntrinsicPrefixMacro {
 		auto oldScope   = parser->currentScope(); 
 		//parse block
 		auto block = new BlockExpression();
-		block->scope->parent = parser->_outerMacroOuterScope;
+		block->scope->changeParent(parser->_outerMacroOuterScope);
 		QuasiParser  quasi(oldScope);
+		quasi.splices = new NodeReference::Splices;
 		parser->currentScope(block->scope);
 		block->scope->define(&quasi);
 		blockParser->body(parser,BlockParser::BlockChildParser(block));
 		block->scope->remove(&quasi);
 		parser->currentScope(oldScope);
-		if(block->size() == 1 && block->scope->numberOfDefinitions() == 0) return new NodeReference(block->childrenPtr()[0]);
-		return new NodeReference(block);
+		auto result = new NodeReference(block->size() == 1 && block->scope->numberOfDefinitions() == 0? block->childrenPtr()[0] : block);
+		result->splices(quasi.splices);
+		return result;
 	}
 };
 
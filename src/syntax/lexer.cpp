@@ -1,5 +1,7 @@
 #include "lexer.h"
+#include "scanning.h"
 #include "../base/utf.h"
+#include "../base/hashmap.h"
 #include "../compiler.h"
 
 static inline bool isDigit(char c){
@@ -31,12 +33,104 @@ unittest(chars){
 	for(auto i =0;i<16;i++) assert(hexToInt(hex[i]) == i);
 }
 
-Lexer::Lexer(const char* source) : location(0,0) {
+TokenBuffer::TokenBuffer(const char* source,Location location) : source(source),next(source),lineStart(source),nextLocation(location) {
+}
+void TokenBuffer::append(const Token& token,Location location,const char* start){
+	uint32 payload = 0;
+	switch(token.type){
+	case Token::Uinteger:
+		payload = uint32(integers.size());
+		integers.push_back(token.uinteger);
+		break;
+	case Token::Real:
+		payload = uint32(reals.size());
+		reals.push_back(token.real);
+		break;
+	case Token::Char:
+		payload = uint32(characters.size());
+		characters.push_back(token.character);
+		break;
+	case Token::String:
+		payload = uint32(strings.size());
+		strings.push_back(token.string);
+		break;
+	}
+	kinds.push_back(uint8(token.type));
+	symbols.push_back(token.symbol);
+	payloads.push_back(payload);
+	locations.push_back(location);
+	offsets.push_back(uint32(start - source));
+}
+Token TokenBuffer::token(size_t index) const {
+	Token result;
+	result.type   = kinds[index];
+	result.symbol = symbols[index];
+	auto payload  = payloads[index];
+	switch(result.type){
+	case Token::Uinteger: result.uinteger  = integers[payload];   break;
+	case Token::Real:     result.real      = reals[payload];      break;
+	case Token::Char:     result.character = characters[payload]; break;
+	case Token::String:   result.string    = strings[payload];    break;
+	}
+	return result;
+}
+size_t TokenBuffer::hash(size_t begin,size_t end) const {
+	size_t result = 0;
+	for(auto i = begin;i<end;i++){
+		result = hashing::combine(result,kinds[i]);
+		auto payload = payloads[i];
+		switch(kinds[i]){
+		case Token::Symbol:   result = hashing::combine(result,symbols[i].hash()); break;
+		case Token::Uinteger: result = hashing::combine(result,hashing::mix(size_t(integers[payload] ^ (integers[payload] >> 32)))); break;
+		case Token::Char:     result = hashing::combine(result,hashing::mix(size_t(characters[payload]))); break;
+		case Token::Real: {
+			uint64 bits;
+			memcpy(&bits,&reals[payload],sizeof(bits));
+			result = hashing::combine(result,hashing::mix(size_t(bits ^ (bits >> 32))));
+			break;
+		}
+		case Token::String: {
+			auto string = strings[payload];
+			for(size_t j = 0;j<string.length();j++) result = hashing::combine(result,uint8(string.ptr()[j]));
+			break;
+		}
+		}
+	}
+	return result;
+}
+
+Lexer::Lexer(const char* source,bool buffered,TokenBuffer* tokens) : location(0,0) {
 	ptr= source;
 	//check for UTF8 BOM
 	if(ptr[0]=='\xEF' && ptr[1]=='\xBB' && ptr[2]=='\xBF') ptr+=3;
 	original= ptr;
 	peeked = false;
+	mixins = false;
+	reportErrors = true;
+	hadErrors = false;
+	buffer = nullptr;
+	position = 0;
+	if(tokens){
+		assert(tokens->source == ptr);
+		buffer = tokens;
+		buffers.push_back(buffer);
+	}
+	else if(buffered){
+		buffer = new TokenBuffer(ptr,location);
+		buffers.push_back(buffer);
+	}
+}
+Lexer::~Lexer(){
+	for(auto i = buffers.begin();i!=buffers.end();++i) delete *i;
+}
+
+TokenBuffer* Lexer::tokenize(const char* source){
+	Lexer lexer(source,true);
+	lexer.reportErrors = false;
+	lexer.fill(size_t(-1));
+	if(lexer.hadErrors) return nullptr;
+	lexer.buffers.clear();
+	return lexer.buffer;
 }
 
 void Lexer::mixin(const char* source,Location& location){
@@ -47,20 +141,36 @@ void Lexer::mixin(const char* source,Location& location){
 	original= ptr;
 	peeked = false;
 	mixins = true;
+	//The mixined source gets its own buffer, the restoration of the state returns to the previous one
+	if(buffer){
+		buffer = new TokenBuffer(ptr,location);
+		buffers.push_back(buffer);
+		position = 0;
+	}
 }
 
 void Lexer::saveState(State *state){
-	state->src= ptr;
-	state->original = original;
 	state->location = location;
 	state->peeked = peeked;
+	state->buffer = buffer;
+	if(buffer){
+		state->position = position;
+		return;
+	}
+	state->src= ptr;
+	state->original = original;
 	state->peekedToken = peekedToken;
 }
 void Lexer::restoreState(State *state){
-	ptr = state->src;
-	original = state->original;
 	location = state->location;
 	peeked = state->peeked;
+	if(state->buffer){
+		buffer = state->buffer;
+		position = state->position;
+		return;
+	}
+	ptr = state->src;
+	original = state->original;
 	peekedToken = state->peekedToken;
 }
 
@@ -132,25 +242,40 @@ void Lexer::lexComment(){
 	ptr++;
 	if(!matchNewline()){
 		//single line comment
-		while(!matchNewline() && *ptr != '\0') ptr++;
+		ptr = scanning::skipToLineEnd(ptr);
+		matchNewline();
 	} else {
-		//multiline comment
+		//multiline comment, which ends with a line that ends with a '#'
 		do {
-			auto prev = *ptr;ptr++;
-			if(matchNewline()){
-				if(prev == '#') break;
-			}
+			ptr = scanning::skipToLineEnd(ptr);
 			if(*ptr == '\0'){
 				onUnexpectedEOF("'#' followed by a newline");
 				break;
 			}
+			auto prev = *(ptr - 1);
+			matchNewline();
+			if(prev == '#') break;
 		} while(true);
 	}
 }
 void Lexer::lexString(Token& token){
 	ptr++;
 	auto begin = ptr;
+	token.type   = Token::String;
+	//Literals without escapes and special newlines are slices of the source
+	for(;;){
+		ptr = scanning::skipToStringEnd(ptr);
+		if(*ptr == '\n') matchNewline();
+		else break;
+	}
+	if(*ptr == '"'){
+		token.string = memory::Block::construct(begin,ptr - begin);
+		ptr++;
+		return;
+	}
+
 	memory::StringLiteralConstructor string;
+	string.append(begin,ptr - begin);
 	for(;(*ptr)!='"';){
 		if(matchNewline()) string.append('\n');
 		else if(*ptr == '\0'){
@@ -158,9 +283,16 @@ void Lexer::lexString(Token& token){
 			ptr--;
 			break;
 		}
-		else string.append(lexChar());
+		else if(*ptr == '\\'){
+			ptr++;
+			string.append(escapeChar());
+		}
+		else {
+			auto end = scanning::skipToStringEnd(ptr);
+			string.append(ptr,end - ptr);
+			ptr = end;
+		}
 	}
-	token.type   = Token::String;
 	token.string = string.toString();
 	ptr++;
 }
@@ -206,14 +338,48 @@ void Lexer::lexDecimal(Token& token){
 	else token.type = Token::Uinteger;
 }
 
+//Lexes the tokens in the buffer up to the given index, returns the index of the Eof token if the source ends before it.
+size_t Lexer::fill(size_t index){
+	if(index < buffer->size()) return index;
+	auto current = location;
+	ptr = buffer->next;
+	original = buffer->lineStart;
+	location = buffer->nextLocation;
+	while(buffer->size() <= index){
+		if(buffer->size() && buffer->kinds.back() == Token::Eof){
+			index = buffer->size() - 1;
+			break;
+		}
+		auto start = ptr;
+		auto token = lex();
+		buffer->append(token,location,start);
+	}
+	buffer->next = ptr;
+	buffer->lineStart = original;
+	buffer->nextLocation = location;
+	location = current;
+	return index;
+}
+
 Token Lexer::consume(){
+	if(buffer){
+		auto index = fill(position);
+		if(index == position) position++;
+		peeked = false;
+		location = buffer->locations[index];
+		return buffer->token(index);
+	}
 	if(peeked){
 		peeked = false;
 		return peekedToken;
 	}
+	return lex();
+}
+
+Token Lexer::lex(){
 	Token token;	
 	//Skip spaces and tabs.
-	while(isSpace(*ptr)) ptr++;
+	if(isSpace(*ptr)) ptr = scanning::skipSpaces(ptr + 1);
 	location.column = int(ptr - original);
 	
 	//lex
@@ -224,7 +390,7 @@ Token Lexer::consume(){
 	else if( isLetter(*ptr) ){
 		//alphabetical symbol
 		const char* start = ptr;
-		for(;(*ptr) > ' ' && (isLetter(*ptr) || isDigit(*ptr) || (*ptr >= 128));ptr++);
+		ptr = scanning::skipIdentifier(ptr + 1);
 		token.symbol = SymbolID(start,ptr);
 		token.type   = Token::Symbol;
 	}
@@ -269,6 +435,13 @@ Token Lexer::consume(){
 }
 
 Token Lexer::peek(){
+	if(buffer){
+		auto index = fill(position);
+		peeked = true;
+		location = buffer->locations[index];
+		if(mixins) prePeek = buffer->source + buffer->offsets[index];
+		return buffer->token(index);
+	}
 	if(!peeked) {
 		if(mixins) prePeek = ptr;
 		peekedToken = consume();
@@ -276,16 +449,37 @@ Token Lexer::peek(){
 	}
 	return peekedToken;
 }
+Token Lexer::lookahead(size_t distance){
+	assert(buffer);
+	return buffer->token(fill(position + distance));
+}
 
 void  Lexer::onUnexpectedEOF(const char* str){
+	if(!reportErrors){
+		hadErrors = true;
+		return;
+	}
 	compiler::onError(location,format("Unexpected end of file reached - Expected %s!",str));
 }
 void  Lexer::onExpectedError(const char* str){
+	if(!reportErrors){
+		hadErrors = true;
+		return;
+	}
 	compiler::onError(location,format("Expected %s instead of '%c'!",str,*ptr));
 }
 void  Lexer::syntaxError(std::string& msg){
+	if(!reportErrors){
+		hadErrors = true;
+		return;
+	}
 	auto loc = previousLocation();
-	if(original == ptr && location.column != 0) loc.lineNumber--;
+	if(buffer){
+		//The current token is the last one which was consumed or peeked
+		auto index = peeked? position : position - 1;
+		if(index < buffer->size() && buffer->kinds[index] == Token::Line && loc.column != 0) loc.lineNumber--;
+	}
+	else if(original == ptr && location.column != 0) loc.lineNumber--;
 	compiler::onError(loc,msg);
 }
 unittest(lexer){
@@ -294,25 +488,50 @@ unittest(lexer){
 #define expectUinteger(n) token = lexer.consume();assert(token.isUinteger() && token.uinteger == n)
 #define expectEof() token = lexer.consume();assert(token.isEOF())
 	
-	auto lexer = Lexer("foo 2 =");
-	assert(lexer.currentLocation().line() == 0);
-	expectSymbol("foo");
-	expectUinteger(2);
-	expectSymbol("=");
-	assert(lexer.currentLocation().line() == 0);
-	expectEof();
-	
+	{
+		Lexer lexer("foo 2 =");
+		assert(lexer.currentLocation().line() == 0);
+		expectSymbol("foo");
+		expectUinteger(2);
+		expectSymbol("=");
+		assert(lexer.currentLocation().line() == 0);
+		expectEof();
+	}
+
+	{
+		Lexer lexer("a_b bar + 5 - 7");
+		assert(lexer.currentLocation().line() == 0);
+		expectSymbol("a_b");
+		expectSymbol("bar");
+		expectSymbol("+");
+		expectUinteger(5);
+		expectSymbol("-");
+		expectUinteger(7);
+		assert(lexer.currentLocation().line() == 0);
+		expectEof();
+	}
+
+	//buffered
+	Lexer buffered("foo\n  bar(2)",true);
+	Lexer::State state;
+	assert(buffered.consume().symbol == SymbolID("foo"));
+	buffered.saveState(&state);
+	assert(buffered.lookahead(2).symbol == SymbolID("("));
+	assert(buffered.consume().isLine());
+	assert(buffered.consume().symbol == SymbolID("bar"));
+	assert(buffered.currentLocation().line() == 1 && buffered.currentLocation().column == 2);
+	buffered.restoreState(&state);
+	assert(buffered.peek().isLine());
+	assert(buffered.lookahead(3).isUinteger() && buffered.lookahead(3).uinteger == 2);
+	assert(buffered.lookahead(10).isEOF());
 
-	lexer = Lexer("a_b bar + 5 - 7");
-	assert(lexer.currentLocation().line() == 0);
-	expectSymbol("a_b");
-	expectSymbol("bar");
-	expectSymbol("+");
-	expectUinteger(5);
-	expectSymbol("-");
-	expectUinteger(7);
-	assert(lexer.currentLocation().line() == 0);
-	expectEof();
+	//tokenized ahead
+	auto tokens = Lexer::tokenize("import foo.bar\n'x'");
+	assert(tokens && tokens->kinds.back() == Token::Eof);
+	Lexer tokenized(tokens->source,false,tokens);
+	assert(tokenized.consume().symbol == SymbolID("import"));
+	assert(tokenized.lookahead(2).symbol == SymbolID("bar"));
+	assert(Lexer::tokenize("\"unterminated") == nullptr);
 
 	//clean up
 	//symbols.~SymbolTable();
@@ -9,8 +9,44 @@
 #include "token.h"
 #include "location.h"
 
+/**
+	The tokens of a source which are stored in a separate array for each attribute.
+	The literal values are stored in the arrays of their type and are referenced by the payload index.
+*/
+struct TokenBuffer {
+	const char* source;
+	std::vector<uint8>    kinds;
+	std::vector<SymbolID> symbols;
+	std::vector<uint32>   payloads;
+	std::vector<Location> locations;//The location of the lexer after the token was lexed
+	std::vector<uint32>   offsets;  //The offset in the source where the lexing of the token started(including the whitespace before it)
+
+	std::vector<uint64>        integers;
+	std::vector<double>        reals;
+	std::vector<UnicodeChar>   characters;
+	std::vector<memory::Block> strings;
+
+	//The state of the lexer after the last token in the buffer
+	const char* next;
+	const char* lineStart;
+	Location    nextLocation;
+
+	TokenBuffer(const char* source,Location location);
+	inline size_t size() const { return kinds.size(); }
+	void  append(const Token& token,Location location,const char* start);
+	Token token(size_t index) const;
+	//Hashes the tokens in the given range, their locations don't affect the hash.
+	size_t hash(size_t begin,size_t end) const;
+};
+
 struct Lexer {
-	Lexer(const char* source);
+	//In the buffered mode the tokens are stored in a token buffer as they are lexed, so backtracking doesn't lex them again.
+	//The tokens can also be given in a buffer which was already filled from the source, the lexer takes the ownership of it.
+	Lexer(const char* source,bool buffered = false,TokenBuffer* tokens = nullptr);
+	~Lexer();
+
+	//Lexes the whole source into a new token buffer without reporting the errors. Returns null if the source has errors.
+	static TokenBuffer* tokenize(const char* source);
 
 	struct State {
 		const char* src;
@@ -18,13 +54,22 @@ struct Lexer {
 		Location location;
 		bool peeked;
 		Token peekedToken;
+		//In the buffered mode only the buffer and the position in it are needed
+		TokenBuffer* buffer;
+		size_t position;
 	};	
 	void saveState(State *state);
 	void restoreState(State *state);
 
 	Token consume();
 	Token peek();
+	//Returns the token which is the given number of tokens after the next one. Only available in the buffered mode.
+	Token lookahead(size_t distance);
 
+	inline bool isBuffered() const { return buffer != nullptr; }
+	//The buffer and the index of the next token in it. Only available in the buffered mode.
+	inline TokenBuffer* tokenBuffer() const { return buffer; }
+	inline size_t tokenPosition() const { return position; }
 	inline Location currentLocation() { return location; }
 	inline Location previousLocation(){ return location; }
 
@@ -39,6 +84,16 @@ protected:
 	bool  mixins;
 	Token peekedToken;
 	const char* prePeek;
+	bool  reportErrors;
+	bool  hadErrors;
+
+	//buffered mode
+	TokenBuffer* buffer;
+	size_t position;//The index of the next token in the buffer
+	std::vector<TokenBuffer*> buffers;
+
+	Token lex();
+	size_t fill(size_t index);
 
 	bool matchNewline();
 	UnicodeChar lexChar();
@@ -52,7 +107,8 @@ protected:
 	
 	void onUnexpectedEOF(const char* str);
 	void onExpectedError(const char* str);
-	
+
+	NOCOPY(Lexer)
 };
 
 #endif
\ No newline at end of file
@@ -10,7 +10,7 @@
 #include "parser.h"
 #include "../intrinsics/types.h"
 
-Parser::Parser(const char* src,CompilationUnit* compilationUnit) : Lexer(src),_compilationUnit(compilationUnit) {  
+Parser::Parser(const char* src,CompilationUnit* compilationUnit,bool bufferTokens,TokenBuffer* tokens) : Lexer(src,bufferTokens,tokens),_compilationUnit(compilationUnit) {  
 	_currentScope = nullptr;
 	_outerMacroOuterScope = nullptr;
 }
@@ -86,6 +86,12 @@ Node* Parser::spliceString(Token& token){
 	if(std::find(begin,end,'$') == end){
 		return new StringLiteral(block);
 	}
+	//The literal can be a slice of the source, so the splices are lexed from a terminated copy
+	auto copy = (char*)memory::allocate(block.length() + 1);
+	memcpy(copy,begin,block.length());
+	copy[block.length()] = '\0';
+	begin = copy;
+	end   = copy + block.length();
 	State state;
 	
 	Node* result = nullptr;
@@ -22,7 +22,7 @@ private:
 	CompilationUnit* _compilationUnit;
 public:
 
-	Parser(const char* src,CompilationUnit* compilationUnit);
+	Parser(const char* src,CompilationUnit* compilationUnit,bool bufferTokens = false,TokenBuffer* tokens = nullptr);
 
 	CompilationUnit* compilationUnit() const;
 
@@ -0,0 +1,269 @@
+#include "scanning.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+	#define ARPHA_SCANNING_X86
+	#include <emmintrin.h>
+	#include <immintrin.h>
+	#ifdef _MSC_VER
+		#include <intrin.h>
+		#define TARGET_SSE2
+		#define TARGET_AVX2
+	#else
+		#define TARGET_SSE2 __attribute__((target("sse2")))
+		#define TARGET_AVX2 __attribute__((target("avx2")))
+	#endif
+#endif
+
+namespace scanning {
+
+static inline bool isIdentifierChar(char c){
+	return (c>='a' && c<='z') || (c>='A' && c<='Z') || (c>='0' && c<='9') || c == '_';
+}
+static inline bool isLineEnd(char c){
+	return c == '\0' || (c >= 0xA && c <= 0xD);
+}
+
+namespace scalar {
+	static const char* identifier(const char* ptr){
+		for(;isIdentifierChar(*ptr);ptr++);
+		return ptr;
+	}
+	static const char* spaces(const char* ptr){
+		for(;*ptr == ' ' || *ptr == '\t';ptr++);
+		return ptr;
+	}
+	static const char* lineEnd(const char* ptr){
+		for(;!isLineEnd(*ptr);ptr++);
+		return ptr;
+	}
+	static const char* stringEnd(const char* ptr){
+		for(;!isLineEnd(*ptr) && *ptr != '"' && *ptr != '\\';ptr++);
+		return ptr;
+	}
+}
+
+#ifdef ARPHA_SCANNING_X86
+
+static inline uint32 firstBit(uint32 mask){
+	#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward(&index,mask);
+		return uint32(index);
+	#else
+		return uint32(__builtin_ctz(mask));
+	#endif
+}
+
+/**
+	Classifies the aligned blocks starting with the one that contains ptr.
+	The classifier returns a bitmask of the bytes where the scanning stops, the bytes before ptr are ignored.
+	The scanning always stops at '\0', so the blocks after the end of the source are never read.
+*/
+#define SCAN_ALIGNED(Vector,width,load,classify) \
+	auto offset = size_t(ptr) & (width - 1); \
+	auto block  = (const Vector*)(ptr - offset); \
+	uint32 stops = uint32(classify(load(block))) >> offset; \
+	if(stops) return ptr + firstBit(stops); \
+	for(block++;;block++){ \
+		stops = uint32(classify(load(block))); \
+		if(stops) return (const char*)block + firstBit(stops); \
+	}
+
+namespace sse2 {
+	TARGET_SSE2 static inline __m128i equal(__m128i x,char c){
+		return _mm_cmpeq_epi8(x,_mm_set1_epi8(c));
+	}
+	//Signed comparison, so that the bytes of the multibyte utf8 sequences are never in the range.
+	TARGET_SSE2 static inline __m128i inRange(__m128i x,char lo,char hi){
+		return _mm_and_si128(_mm_cmpgt_epi8(x,_mm_set1_epi8(lo - 1)),_mm_cmplt_epi8(x,_mm_set1_epi8(hi + 1)));
+	}
+	TARGET_SSE2 static inline __m128i lineEnds(__m128i x){
+		return _mm_or_si128(equal(x,'\0'),inRange(x,0xA,0xD));
+	}
+
+	TARGET_SSE2 static inline uint32 identifierStops(__m128i x){
+		auto lower = _mm_or_si128(x,_mm_set1_epi8(0x20));
+		auto match = _mm_or_si128(_mm_or_si128(inRange(lower,'a','z'),inRange(x,'0','9')),equal(x,'_'));
+		return ~uint32(_mm_movemask_epi8(match)) & 0xFFFF;
+	}
+	TARGET_SSE2 static inline uint32 spaceStops(__m128i x){
+		return ~uint32(_mm_movemask_epi8(_mm_or_si128(equal(x,' '),equal(x,'\t')))) & 0xFFFF;
+	}
+	TARGET_SSE2 static inline uint32 lineEndStops(__m128i x){
+		return uint32(_mm_movemask_epi8(lineEnds(x)));
+	}
+	TARGET_SSE2 static inline uint32 stringEndStops(__m128i x){
+		return uint32(_mm_movemask_epi8(_mm_or_si128(lineEnds(x),_mm_or_si128(equal(x,'"'),equal(x,'\\')))));
+	}
+
+	TARGET_SSE2 static const char* identifier(const char* ptr){
+		SCAN_ALIGNED(__m128i,16,_mm_load_si128,identifierStops)
+	}
+	TARGET_SSE2 static const char* spaces(const char* ptr){
+		SCAN_ALIGNED(__m128i,16,_mm_load_si128,spaceStops)
+	}
+	TARGET_SSE2 static const char* lineEnd(const char* ptr){
+		SCAN_ALIGNED(__m128i,16,_mm_load_si128,lineEndStops)
+	}
+	TARGET_SSE2 static const char* stringEnd(const char* ptr){
+		SCAN_ALIGNED(__m128i,16,_mm_load_si128,stringEndStops)
+	}
+}
+
+namespace avx2 {
+	TARGET_AVX2 static inline __m256i equal(__m256i x,char c){
+		return _mm256_cmpeq_epi8(x,_mm256_set1_epi8(c));
+	}
+	TARGET_AVX2 static inline __m256i inRange(__m256i x,char lo,char hi){
+		return _mm256_and_si256(_mm256_cmpgt_epi8(x,_mm256_set1_epi8(lo - 1)),_mm256_cmpgt_epi8(_mm256_set1_epi8(hi + 1),x));
+	}
+	TARGET_AVX2 static inline __m256i lineEnds(__m256i x){
+		return _mm256_or_si256(equal(x,'\0'),inRange(x,0xA,0xD));
+	}
+
+	TARGET_AVX2 static inline uint32 identifierStops(__m256i x){
+		auto lower = _mm256_or_si256(x,_mm256_set1_epi8(0x20));
+		auto match = _mm256_or_si256(_mm256_or_si256(inRange(lower,'a','z'),inRange(x,'0','9')),equal(x,'_'));
+		return ~uint32(_mm256_movemask_epi8(match));
+	}
+	TARGET_AVX2 static inline uint32 spaceStops(__m256i x){
+		return ~uint32(_mm256_movemask_epi8(_mm256_or_si256(equal(x,' '),equal(x,'\t'))));
+	}
+	TARGET_AVX2 static inline uint32 lineEndStops(__m256i x){
+		return uint32(_mm256_movemask_epi8(lineEnds(x)));
+	}
+	TARGET_AVX2 static inline uint32 stringEndStops(__m256i x){
+		return uint32(_mm256_movemask_epi8(_mm256_or_si256(lineEnds(x),_mm256_or_si256(equal(x,'"'),equal(x,'\\')))));
+	}
+
+	TARGET_AVX2 static const char* identifier(const char* ptr){
+		SCAN_ALIGNED(__m256i,32,_mm256_load_si256,identifierStops)
+	}
+	TARGET_AVX2 static const char* spaces(const char* ptr){
+		SCAN_ALIGNED(__m256i,32,_mm256_load_si256,spaceStops)
+	}
+	TARGET_AVX2 static const char* lineEnd(const char* ptr){
+		SCAN_ALIGNED(__m256i,32,_mm256_load_si256,lineEndStops)
+	}
+	TARGET_AVX2 static const char* stringEnd(const char* ptr){
+		SCAN_ALIGNED(__m256i,32,_mm256_load_si256,stringEndStops)
+	}
+}
+
+#undef SCAN_ALIGNED
+
+static bool cpuSupports(Implementation implementation){
+	#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info,0);
+		auto maxLeaf = info[0];
+		__cpuid(info,1);
+		if(implementation == SSE2) return (info[3] & (1<<26)) != 0;
+		//AVX2 also requires the OS to save the ymm registers
+		if(maxLeaf < 7 || !(info[2] & (1<<27)) || (_xgetbv(0) & 6) != 6) return false;
+		__cpuidex(info,7,0);
+		return (info[1] & (1<<5)) != 0;
+	#else
+		__builtin_cpu_init();
+		if(implementation == SSE2) return __builtin_cpu_supports("sse2") != 0;
+		return __builtin_cpu_supports("avx2") != 0;
+	#endif
+}
+
+#endif
+
+bool isSupported(Implementation implementation){
+	if(implementation == Scalar) return true;
+	#ifdef ARPHA_SCANNING_X86
+		return cpuSupports(implementation);
+	#else
+		return false;
+	#endif
+}
+Implementation best(){
+	if(isSupported(AVX2)) return AVX2;
+	if(isSupported(SSE2)) return SSE2;
+	return Scalar;
+}
+
+static Functions implementationFunctions(Implementation implementation){
+	Functions result = { scalar::identifier,scalar::spaces,scalar::lineEnd,scalar::stringEnd };
+	#ifdef ARPHA_SCANNING_X86
+		if(implementation == SSE2){
+			Functions f = { sse2::identifier,sse2::spaces,sse2::lineEnd,sse2::stringEnd };
+			result = f;
+		}
+		else if(implementation == AVX2){
+			Functions f = { avx2::identifier,avx2::spaces,avx2::lineEnd,avx2::stringEnd };
+			result = f;
+		}
+	#endif
+	return result;
+}
+
+static Implementation current = Scalar;
+static bool implementationSelected = false;
+
+/**
+	The table is constant initialized with the functions which select the best implementation on the first call,
+	so the table can be used during the dynamic initialization of the other translation units e.g. by their unittests.
+*/
+static void selectBest(){
+	if(!implementationSelected) select(best());
+}
+static const char* firstIdentifier(const char* ptr){ selectBest(); return functions.identifier(ptr); }
+static const char* firstSpaces(const char* ptr)    { selectBest(); return functions.spaces(ptr); }
+static const char* firstLineEnd(const char* ptr)   { selectBest(); return functions.lineEnd(ptr); }
+static const char* firstStringEnd(const char* ptr) { selectBest(); return functions.stringEnd(ptr); }
+
+Functions functions = { firstIdentifier,firstSpaces,firstLineEnd,firstStringEnd };
+
+void select(Implementation implementation){
+	assert(isSupported(implementation));
+	current = implementation;
+	functions = implementationFunctions(implementation);
+	implementationSelected = true;
+}
+Implementation selected(){
+	selectBest();
+	return current;
+}
+const char* name(Implementation implementation){
+	switch(implementation){
+	case SSE2: return "SSE2";
+	case AVX2: return "AVX2";
+	default:   return "scalar";
+	}
+}
+
+unittest(scanning){
+	const char* samples[] = {
+		"a_Zz09 \t \tfoo_bar_baz_qux_quux_corge_grault_garply_waldo \"s\\n\" # comment\n",
+		"                                                                   \t\tx",
+		"identifier_which_is_longer_than_two_vector_registers_of_any_width@",
+		"string contents which are quite long and don't have any escapes\"",
+		"comment body which ends with a carriage return and line feed\r\n",
+		"\xC3\xA9t\xC3\xA9 \"\xE2\x82\xAC\" \v\f"
+	};
+	auto reference = implementationFunctions(Scalar);
+	char buffer[256];
+	for(int impl = SSE2;impl <= AVX2;impl++){
+		if(!isSupported(Implementation(impl))) continue;
+		auto f = implementationFunctions(Implementation(impl));
+		for(size_t sample = 0;sample < sizeof(samples)/sizeof(samples[0]);sample++){
+			auto length = strlen(samples[sample]);
+			for(size_t offset = 0;offset < 64;offset++){
+				memset(buffer,'x',sizeof(buffer));
+				memcpy(buffer + offset,samples[sample],length + 1);
+				for(auto ptr = buffer + offset;ptr < buffer + offset + length;ptr++){
+					assert(f.identifier(ptr) == reference.identifier(ptr));
+					assert(f.spaces(ptr)     == reference.spaces(ptr));
+					assert(f.lineEnd(ptr)    == reference.lineEnd(ptr));
+					assert(f.stringEnd(ptr)  == reference.stringEnd(ptr));
+				}
+			}
+		}
+	}
+}
+
+}
@@ -0,0 +1,46 @@
+/**
+* This module provides the functions which the lexer uses to skip over runs of characters.
+* They have SSE2 and AVX2 implementations, the best one supported by the processor is chosen on the first use.
+*/
+#ifndef ARPHA_SCANNING_H
+#define ARPHA_SCANNING_H
+
+#include "../base/base.h"
+
+namespace scanning {
+	enum Implementation {
+		Scalar,SSE2,AVX2
+	};
+
+	/**
+		The source has to be terminated by a '\0', which stops all of the functions.
+		The vector implementations only read aligned blocks which contain at least one byte of the source, so they
+		never read across a page boundary.
+	*/
+	struct Functions {
+		//Returns the pointer to the first character which isn't a letter, digit or '_'.
+		const char* (*identifier)(const char* ptr);
+		//Returns the pointer to the first character which isn't ' ' or '\t'.
+		const char* (*spaces)(const char* ptr);
+		//Returns the pointer to the first newline character or '\0'.
+		const char* (*lineEnd)(const char* ptr);
+		//Returns the pointer to the first '"', '\\', newline character or '\0'.
+		const char* (*stringEnd)(const char* ptr);
+	};
+	extern Functions functions;
+
+	//Returns the best implementation that is supported by the processor.
+	Implementation best();
+	bool isSupported(Implementation implementation);
+	//Switches to the given implementation, which has to be supported.
+	void select(Implementation implementation);
+	Implementation selected();
+	const char* name(Implementation implementation);
+
+	inline const char* skipIdentifier(const char* ptr){ return functions.identifier(ptr); }
+	inline const char* skipSpaces(const char* ptr){ return functions.spaces(ptr); }
+	inline const char* skipToLineEnd(const char* ptr){ return functions.lineEnd(ptr); }
+	inline const char* skipToStringEnd(const char* ptr){ return functions.stringEnd(ptr); }
+}
+
+#endif
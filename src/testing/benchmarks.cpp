@@ -0,0 +1,143 @@
+/**
+* This module contains the microbenchmarks for the performance sensitive parts of the compiler.
+* They are run with 'arpha benchmark'.
+*/
+#include <limits>
+#include "../base/base.h"
+#include "../base/format.h"
+#include "../base/system.h"
+#include "../base/bigint.h"
+#include "../base/hashmap.h"
+#include "../syntax/lexer.h"
+#include "../syntax/scanning.h"
+
+#include "../compiler.h"
+
+namespace {
+	//Stores the results so that the optimizer can't remove the measured code
+	volatile uint64 sink;
+
+	//Prints the average time of one iteration of the given function
+	template<typename F>
+	void measure(const char* name,size_t iterations,F f){
+		auto start = System::time();
+		for(size_t i = 0;i<iterations;i++) f(i);
+		auto elapsed = System::time() - start;
+		System::print(format("  %s: %s ns per iteration\n",name,uint64(elapsed*1e9/double(iterations))));
+	}
+
+	void benchmarkBigInt(){
+		System::print("BigInt:\n");
+		measure("single word addition",10000000,[](size_t i){
+			BigInt a((uint64)i);
+			a += BigInt((int64)-42);
+			sink = a.u64;
+		});
+		measure("single word multiplication",10000000,[](size_t i){
+			BigInt a((uint64)i & 0xFFFF);
+			a *= BigInt((uint64)1000);
+			sink = a.u64;
+		});
+		measure("single word division",10000000,[](size_t i){
+			BigInt a((uint64)i);
+			a /= BigInt((uint64)7);
+			sink = a.u64;
+		});
+
+		//2^64 + 12345 requires two words
+		BigInt big((uint64)std::numeric_limits<uint64>::max());
+		big += BigInt((uint64)12346);
+		measure("multi word addition",1000000,[&](size_t i){
+			BigInt a(big);
+			a += BigInt((uint64)i);
+			sink = a.word(0);
+		});
+		measure("multi word multiplication",1000000,[&](size_t i){
+			BigInt a(big);
+			a *= big;
+			sink = a.word(0);
+		});
+		measure("multi word division",100000,[&](size_t i){
+			BigInt a(big);
+			a *= big;
+			a /= big;
+			sink = a.word(0);
+		});
+	}
+
+	//Compares the scope definition maps with std::map for a scope with the given number of definitions
+	void benchmarkSymbolMap(size_t definitions){
+		std::vector<SymbolID> names;
+		char name[32];
+		for(size_t i = 0;i<definitions*2;i++){
+			sprintf(name,"definition%d",int(i));
+			names.push_back(SymbolID(name));
+		}
+		std::map<SymbolID,void*> map;
+		SmallHashMap<SymbolID,void*> hashMap;
+		for(size_t i = 0;i<definitions;i++){
+			map[names[i]] = &names[i];
+			hashMap[names[i]] = &names[i];
+		}
+		//Half of the lookups miss, like the lookups of the symbols which are defined in the outer scopes
+		auto mask = names.size() - 1;
+		System::print(format("  %s definitions:\n",definitions));
+		measure("  std::map lookup",10000000,[&](size_t i){
+			auto r = map.find(names[i & mask]);
+			sink = r != map.end()? 1 : 0;
+		});
+		measure("  SmallHashMap lookup",10000000,[&](size_t i){
+			sink = hashMap.find(names[i & mask])? 1 : 0;
+		});
+	}
+	void benchmarkSymbolMaps(){
+		System::print("Scope definition maps:\n");
+		benchmarkSymbolMap(4);
+		benchmarkSymbolMap(8);
+		benchmarkSymbolMap(64);
+		benchmarkSymbolMap(1024);
+	}
+
+	//Lexes all of the modules in the packages directory with every supported scanning implementation
+	void benchmarkLexer(const char* packagesDirectory){
+		std::vector<std::string> paths;
+		System::findFiles(packagesDirectory,"arp",paths);
+		std::vector<System::SourceBuffer*> sources;
+		size_t bytes = 0;
+		for(auto i = paths.begin();i!=paths.end();++i){
+			if(auto source = System::SourceBuffer::open((*i).c_str())){
+				sources.push_back(source);
+				bytes += source->size();
+			}
+		}
+		System::print(format("Lexer(%s files, %s bytes in '%s'):\n",sources.size(),bytes,packagesDirectory));
+		if(!bytes) return;
+
+		//Each measurement lexes about 64MB
+		size_t iterations = std::max(size_t(1),size_t(64*1024*1024)/bytes);
+		auto previous = scanning::selected();
+		for(int impl = scanning::Scalar;impl <= scanning::AVX2;impl++){
+			if(!scanning::isSupported(scanning::Implementation(impl))) continue;
+			scanning::select(scanning::Implementation(impl));
+			uint64 tokens = 0;
+			auto start = System::time();
+			for(size_t i = 0;i<iterations;i++){
+				for(auto source = sources.begin();source!=sources.end();++source){
+					Lexer lexer((*source)->data());
+					while(!lexer.consume().isEOF()) tokens++;
+				}
+			}
+			auto elapsed = System::time() - start;
+			sink = tokens;
+			System::print(format("  %s: %s MB/s\n",scanning::name(scanning::Implementation(impl)),uint64(double(bytes*iterations)/(elapsed*1024.0*1024.0))));
+		}
+		scanning::select(previous);
+		for(auto source = sources.begin();source!=sources.end();++source) (*source)->release();
+	}
+}
+
+void runBenchmarks(const char* packagesDirectory){
+	benchmarkBigInt();
+	benchmarkSymbolMaps();
+	benchmarkLexer(packagesDirectory);
+}